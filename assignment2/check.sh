@@ -0,0 +1,49 @@
+#!/bin/sh
+# Checks that the engines agree.  Run from this directory after make, or as
+# make check.  Prints one line per check and exits 1 if any of them failed.
+
+failed=0
+
+# same board and seed through the direct engine and HashLife, the printed
+# generations have to be the same byte for byte, on power of two boards and
+# on ones that aren't
+for board in "32 64" "40 300" "37 53" "100 100"
+do
+	for printEvery in 1 7 50
+	do
+		./life 2000 300 $printEvery $board -seed 5 > check_direct.out 2>&1
+		./life 2000 300 $printEvery $board -seed 5 -engine hashlife > check_hashlife.out 2>&1
+		if cmp -s check_direct.out check_hashlife.out
+		then
+			echo "ok    hashlife $board every $printEvery"
+		else
+			echo "FAIL  hashlife $board every $printEvery"
+			failed=1
+		fi
+	done
+done
+rm -f check_direct.out check_hashlife.out
+
+# a board just past 2^31 cells (64 x 33554433), one generation through the
+# vector kernel on two ranks, which sends halos and frames as row datatypes,
+# and through the scalar kernel on one rank, whose block alone is past 2^31,
+# has to give the same frame.  It needs about 5 GB and a few minutes, so it
+# is skipped on smaller machines.  MPIRUN is how to start two ranks.
+available=`awk '/^MemAvailable:/ { print $2 }' /proc/meminfo 2>/dev/null`
+if [ "${available:-0}" -ge 5000000 ]
+then
+	${MPIRUN:-mpirun} -n 2 ./life 500000000 1 1 64 33554433 -seed 5 -frames check_vector > /dev/null 2>&1
+	./life 500000000 1 1 64 33554433 -seed 5 -kernel scalar -frames check_scalar > /dev/null 2>&1
+	if [ -s check_vector_00000001.pbm ] && cmp -s check_vector_00000001.pbm check_scalar_00000001.pbm
+	then
+		echo "ok    64 x 33554433 vector on 2 ranks against scalar"
+	else
+		echo "FAIL  64 x 33554433 vector on 2 ranks against scalar"
+		failed=1
+	fi
+	rm -f check_vector_00000001.pbm check_scalar_00000001.pbm
+else
+	echo "skip  64 x 33554433, less than 5 GB of memory free"
+fi
+
+exit $failed
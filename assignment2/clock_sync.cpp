@@ -0,0 +1,118 @@
+#include "clock_sync.h"
+
+/*
+Rank 0 serves the other ranks one after the other.  In one exchange a rank
+notes its time t0 and sends an empty request, rank 0 notes t1 when it gets it
+and t2 when it sends back both, and the rank notes t3 when the reply is in.
+The offset of rank 0's clock is then ((t1 - t0) + (t2 - t3)) / 2, which is
+right if the request and the reply took equally long, and the exchange took
+(t3 - t0) - (t2 - t1) on the wire.  Rank 0's offset is 0 by definition.
+*/
+
+static const int SYNC_TAG = 7001;
+
+// one sync point: the offset with the smallest round trip, and my time then
+static void measureOffset(ClockSync& clock, MPI_Comm comm, int samples, double& when, double& offset)
+{
+	int myRank;
+	int commSize;
+	MPI_Comm_rank(comm, &myRank);
+	MPI_Comm_size(comm, &commSize);
+
+	when = MPI_Wtime();
+	offset = 0;
+	clock.delay = 0;
+
+	if (myRank == 0)
+	{
+		for (int rank = 1; rank < commSize; rank++)
+		{
+			for (int sample = 0; sample < samples; sample++)
+			{
+				double times[2];
+				MPI_Recv(NULL, 0, MPI_BYTE, rank, SYNC_TAG, comm, MPI_STATUS_IGNORE);
+				times[0] = MPI_Wtime();
+				times[1] = MPI_Wtime();
+				MPI_Send(times, 2, MPI_DOUBLE, rank, SYNC_TAG, comm);
+			}
+		}
+		return;
+	}
+
+	for (int sample = 0; sample < samples; sample++)
+	{
+		double times[2];
+		double sent = MPI_Wtime();
+		MPI_Send(NULL, 0, MPI_BYTE, 0, SYNC_TAG, comm);
+		MPI_Recv(times, 2, MPI_DOUBLE, 0, SYNC_TAG, comm, MPI_STATUS_IGNORE);
+		double received = MPI_Wtime();
+
+		double delay = (received - sent) - (times[1] - times[0]);
+		if (sample == 0 || delay < clock.delay)
+		{
+			clock.delay = delay;
+			offset = ((times[0] - sent) + (times[1] - received)) / 2;
+			when = (sent + received) / 2;
+		}
+	}
+}
+
+// adds a sync point and fits the line through all of them
+static void addPoint(ClockSync& clock, double when, double offset)
+{
+	double x = when - clock.reference;
+
+	clock.points++;
+	clock.sumX += x;
+	clock.sumY += offset;
+	clock.sumXX += x * x;
+	clock.sumXY += x * offset;
+
+	double spread = clock.points * clock.sumXX - clock.sumX * clock.sumX;
+	if (clock.points < 2 || spread <= 0)
+	{
+		// one point, or all at the same time: no drift to be seen
+		clock.drift = 0;
+		clock.offset = clock.sumY / clock.points;
+		return;
+	}
+
+	clock.drift = (clock.points * clock.sumXY - clock.sumX * clock.sumY) / spread;
+	clock.offset = (clock.sumY - clock.drift * clock.sumX) / clock.points;
+}
+
+void startClockSync(ClockSync& clock, MPI_Comm comm, int samples)
+{
+	clock.points = 0;
+	clock.sumX = 0;
+	clock.sumY = 0;
+	clock.sumXX = 0;
+	clock.sumXY = 0;
+	clock.offset = 0;
+	clock.drift = 0;
+
+	double when;
+	double offset;
+	measureOffset(clock, comm, samples, when, offset);
+
+	clock.reference = when;
+	addPoint(clock, when, offset);
+}
+
+void resyncClocks(ClockSync& clock, MPI_Comm comm, int samples)
+{
+	double when;
+	double offset;
+	measureOffset(clock, comm, samples, when, offset);
+	addPoint(clock, when, offset);
+}
+
+double toGlobalTime(const ClockSync& clock, double localTime)
+{
+	return localTime + clock.offset + clock.drift * (localTime - clock.reference);
+}
+
+double globalTime(const ClockSync& clock)
+{
+	return toGlobalTime(clock, MPI_Wtime());
+}
@@ -0,0 +1,57 @@
+#ifndef BK_CLOCK_SYNC_H
+#define BK_CLOCK_SYNC_H
+
+#include <mpi.h>
+
+/*
+	A global timebase for all the ranks of a communicator: rank 0's
+	MPI_Wtime.  Every other rank finds the offset of its clock from rank 0's
+	the way NTP does, with a few request and reply exchanges, keeping the
+	one that took the least time since its offset has the smallest error
+	(at most half of that time).  Clocks run at slightly different speeds,
+	so syncing again later in the run adds another offset, and a straight
+	line through all of them (least squares, kept as running sums) gives
+	the offset at any time and how fast it drifts.
+
+	ping_pong -oneWay, collectives -globalClock and life -timing use it.
+	The C examples in the top directory (mpi_odd_even.c, mpi_allreduce.c,
+	mpi_greetings.c, homework2.c) don't time anything, so they are left
+	alone, and this is C++ anyway.
+*/
+struct ClockSync
+{
+	// my MPI_Wtime at the first sync, times are measured from here
+	double reference;
+
+	// running sums of the sync points, x the time since reference and y the
+	// offset measured then
+	int points;
+	double sumX;
+	double sumY;
+	double sumXX;
+	double sumXY;
+
+	// rank 0's clock = my clock + offset + drift * (my clock - reference)
+	double offset;
+	double drift;
+
+	// the round trip of the best exchange of the last sync, the offset is
+	// off by at most half of it
+	double delay;
+};
+
+// collective over comm, forgets any earlier syncs and measures the offset
+// with samples exchanges per rank
+void startClockSync(ClockSync& clock, MPI_Comm comm, int samples);
+
+// collective over comm, measures the offset again and fits the drift
+// through every sync so far
+void resyncClocks(ClockSync& clock, MPI_Comm comm, int samples);
+
+// localTime (an MPI_Wtime of mine) on rank 0's clock
+double toGlobalTime(const ClockSync& clock, double localTime);
+
+// MPI_Wtime on rank 0's clock
+double globalTime(const ClockSync& clock);
+
+#endif
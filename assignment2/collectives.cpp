@@ -0,0 +1,591 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <mpi.h>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include "clock_sync.h"
+
+/*
+This program times the collective operations the other programs use the way
+ping_pong times sends and receives.  life.cpp reads and writes the board with
+MPI-IO and fills it on every rank, so its collectives are small ones: an
+MPI_Ireduce of the -stats numbers and an MPI_Allreduce of the -detectCycles
+fingerprint every generation, an MPI_Allgather of compute times for -balance,
+an MPI_Bcast of the seed and MPI_Reduce for -timing.  mpi_odd_even.c
+broadcasts and gathers.  Every operation goes through a sweep of message
+sizes, doubling from -sizes min to max bytes per process, on 2, 4, 8, ...
+processes and on all of them.  The data are ints, so a size is rounded down
+to a whole number of ints (at least one).
+
+Every timed call starts right after an MPI_Barrier, every process times its
+own call, and what counts for an iteration is the slowest process, since a
+collective isn't done until everybody is done.  Rank 0 sorts those and writes
+the min, median, 99th percentile and max, as CSV or as JSON lines.  Some
+processes always leave the barrier a little after the others, and that time
+is in the numbers too.
+
+With -globalClock the clocks are synced (clock_sync.cpp) on every
+communicator and again after every size, and an iteration counts from the
+first process going in to the last one coming out, on rank 0's clock.  That
+is how long the collective really took, late starters included, instead of
+the longest any one process spent in it.
+
+"butterfly" is the allreduce from mpi_allreduce.c, the sums going back and
+forth between partners that differ in one bit of the rank, for every bit.  It
+works on a whole buffer instead of one int, swaps the partial sums with
+MPI_Sendrecv since two blocking sends towards each other would hang once the
+message is too big for MPI to buffer, and leaves out the barrier before every
+step, which was only there for the debugging printout.  It needs a power of
+2 processes, so it is skipped on the others.  gatherv and scatterv give the
+processes alternately half and one and a half times the size, so the v in
+them does something.
+
+After the timed calls every process checks its result and rank 0 reports how
+many ints came out wrong, added up over all the processes.
+*/
+
+using namespace std;
+
+// buffers and counts for one operation at one size on one communicator
+struct Collective
+{
+	MPI_Comm comm;
+	int myRank;
+	int commSize;
+	int count;
+
+	int* sendBuffer;
+	int* receiveBuffer;
+
+	// per process counts and offsets for gatherv and scatterv
+	vector<int> counts;
+	vector<int> displacements;
+};
+
+void broadcast(Collective& collective);
+void reduce(Collective& collective);
+void allreduce(Collective& collective);
+void gather(Collective& collective);
+void gatherv(Collective& collective);
+void scatter(Collective& collective);
+void scatterv(Collective& collective);
+void alltoall(Collective& collective);
+void butterfly(Collective& collective);
+
+typedef void (*CollectiveOperation)(Collective& collective);
+
+// which processes end up with a result to check
+const int RESULT_ON_ROOT = 0;
+const int RESULT_ON_ALL = 1;
+
+struct OperationEntry
+{
+	const char* name;
+	CollectiveOperation run;
+	int result;
+	bool powerOfTwo;
+};
+
+const OperationEntry OPERATIONS[] = {
+	{ "bcast", broadcast, RESULT_ON_ALL, false },
+	{ "reduce", reduce, RESULT_ON_ROOT, false },
+	{ "allreduce", allreduce, RESULT_ON_ALL, false },
+	{ "butterfly", butterfly, RESULT_ON_ALL, true },
+	{ "gather", gather, RESULT_ON_ROOT, false },
+	{ "gatherv", gatherv, RESULT_ON_ROOT, false },
+	{ "scatter", scatter, RESULT_ON_ALL, false },
+	{ "scatterv", scatterv, RESULT_ON_ALL, false },
+	{ "alltoall", alltoall, RESULT_ON_ALL, false },
+};
+const int OPERATION_COUNT = sizeof(OPERATIONS) / sizeof(OPERATIONS[0]);
+
+// what rank 0 reports for one operation at one size on one number of
+// processes, times in seconds
+struct CollectiveResult
+{
+	const char* operation;
+	int processes;
+	long long bytes;
+	int iterations;
+	long long errors;
+	double minimum;
+	double median;
+	double p99;
+	double maximum;
+};
+
+void printUsage();
+bool operationSelected(const char* operationList, const char* name);
+void prepare(Collective& collective, int operation);
+long long check(const Collective& collective, int operation);
+double percentile(const vector<double>& sortedTimes, double fraction);
+void writeHeader(ostream& out, bool json);
+void writeResult(ostream& out, bool json, const CollectiveResult& result);
+
+const int MAX_SIZE = 1 << 20;
+const int ITERATIONS = 1000;
+const int WARMUP = 10;
+const int CLOCK_SAMPLES = 20;
+
+int main(int argc, char *argv[])
+{
+	int commSize;
+	int myRank;
+
+	int minimumSize = sizeof(int);
+	int maximumSize = MAX_SIZE;
+	int iterations = ITERATIONS;
+	int warmup = WARMUP;
+	bool json = false;
+	bool useGlobalClock = false;
+	const char* outputFile = NULL;
+	const char* operationList = NULL;
+
+	for (int argument = 1; argument < argc; argument++)
+	{
+		if (strcmp(argv[argument], "-sizes") == 0 && argument + 2 < argc)
+		{
+			minimumSize = atoi(argv[argument + 1]);
+			maximumSize = atoi(argv[argument + 2]);
+			argument += 2;
+		}
+		else if (strcmp(argv[argument], "-iterations") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			iterations = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-warmup") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			warmup = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-operations") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			operationList = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-format") == 0 && argument + 1 < argc
+			&& (strcmp(argv[argument + 1], "csv") == 0 || strcmp(argv[argument + 1], "json") == 0))
+		{
+			argument++;
+			json = strcmp(argv[argument], "json") == 0;
+		}
+		else if (strcmp(argv[argument], "-output") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			outputFile = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-globalClock") == 0)
+		{
+			useGlobalClock = true;
+		}
+		else
+		{
+			printUsage();
+			exit(1);
+		}
+	}
+
+	if (minimumSize < 1 || minimumSize > maximumSize || iterations < 1 || warmup < 0)
+	{
+		printUsage();
+		exit(1);
+	}
+
+	// every name in -operations has to be an operation
+	if (operationList != NULL)
+	{
+		int selected = 0;
+		for (int operation = 0; operation < OPERATION_COUNT; operation++)
+		{
+			selected += operationSelected(operationList, OPERATIONS[operation].name) ? 1 : 0;
+		}
+		if (selected != 1 + (int)count(operationList, operationList + strlen(operationList), ','))
+		{
+			printUsage();
+			exit(1);
+		}
+	}
+
+	MPI_Init(NULL, NULL);
+	MPI_Comm_size(MPI_COMM_WORLD, &commSize);
+	MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+	ofstream outputStream;
+	if (myRank == 0 && outputFile != NULL)
+	{
+		outputStream.open(outputFile);
+	}
+	ostream& out = (outputFile != NULL) ? outputStream : cout;
+
+	// big enough for everybody's part of the largest size, at one and a half
+	// times the size for the v versions
+	int maximumCount = max(1, maximumSize / (int)sizeof(int));
+	long long bufferCount = (long long)commSize * (maximumCount + maximumCount / 2 + 1);
+	vector<int> sendBuffer(bufferCount);
+	vector<int> receiveBuffer(bufferCount);
+
+	if (myRank == 0)
+	{
+		writeHeader(out, json);
+	}
+
+	// 2, 4, 8, ... processes, and all of them at the end
+	vector<int> processCounts;
+	for (int processes = 2; processes < commSize; processes *= 2)
+	{
+		processCounts.push_back(processes);
+	}
+	processCounts.push_back(commSize);
+
+	vector<double> times(iterations);
+	vector<double> slowestTimes(iterations);
+	vector<double> startTimes(iterations);
+	vector<double> endTimes(iterations);
+	vector<double> firstStarts(iterations);
+	vector<double> lastEnds(iterations);
+
+	for (size_t run = 0; run < processCounts.size(); run++)
+	{
+		int processes = processCounts[run];
+
+		Collective collective;
+		MPI_Comm_split(MPI_COMM_WORLD, (myRank < processes) ? 0 : MPI_UNDEFINED, myRank, &collective.comm);
+		collective.sendBuffer = &sendBuffer[0];
+		collective.receiveBuffer = &receiveBuffer[0];
+
+		// the processes that sit this one out go on to the next
+		if (collective.comm == MPI_COMM_NULL)
+		{
+			continue;
+		}
+
+		collective.myRank = myRank;
+		collective.commSize = processes;
+		bool powerOfTwo = (processes & (processes - 1)) == 0;
+
+		ClockSync clock;
+		if (useGlobalClock)
+		{
+			startClockSync(clock, collective.comm, CLOCK_SAMPLES);
+		}
+
+		for (int operation = 0; operation < OPERATION_COUNT; operation++)
+		{
+			if ((operationList != NULL && !operationSelected(operationList, OPERATIONS[operation].name))
+				|| (OPERATIONS[operation].powerOfTwo && !powerOfTwo))
+			{
+				continue;
+			}
+
+			for (int currentSize = minimumSize; currentSize <= maximumSize; currentSize *= 2)
+			{
+				collective.count = max(1, currentSize / (int)sizeof(int));
+				prepare(collective, operation);
+
+				for (int i = 0; i < warmup; i++)
+				{
+					MPI_Barrier(collective.comm);
+					OPERATIONS[operation].run(collective);
+				}
+
+				for (int i = 0; i < iterations; i++)
+				{
+					MPI_Barrier(collective.comm);
+					startTimes[i] = MPI_Wtime();
+					OPERATIONS[operation].run(collective);
+					endTimes[i] = MPI_Wtime();
+					times[i] = endTimes[i] - startTimes[i];
+				}
+
+				if (useGlobalClock)
+				{
+					// the first one in to the last one out of every iteration
+					resyncClocks(clock, collective.comm, CLOCK_SAMPLES);
+					for (int i = 0; i < iterations; i++)
+					{
+						startTimes[i] = toGlobalTime(clock, startTimes[i]);
+						endTimes[i] = toGlobalTime(clock, endTimes[i]);
+					}
+					MPI_Reduce(&startTimes[0], &firstStarts[0], iterations, MPI_DOUBLE, MPI_MIN, 0, collective.comm);
+					MPI_Reduce(&endTimes[0], &lastEnds[0], iterations, MPI_DOUBLE, MPI_MAX, 0, collective.comm);
+					for (int i = 0; i < iterations; i++)
+					{
+						slowestTimes[i] = lastEnds[i] - firstStarts[i];
+					}
+				}
+				else
+				{
+					// the slowest process of every iteration
+					MPI_Reduce(&times[0], &slowestTimes[0], iterations, MPI_DOUBLE, MPI_MAX, 0, collective.comm);
+				}
+
+				long long errors = check(collective, operation);
+				long long totalErrors;
+				MPI_Reduce(&errors, &totalErrors, 1, MPI_LONG_LONG, MPI_SUM, 0, collective.comm);
+
+				if (myRank == 0)
+				{
+					sort(slowestTimes.begin(), slowestTimes.end());
+
+					CollectiveResult result;
+					result.operation = OPERATIONS[operation].name;
+					result.processes = processes;
+					result.bytes = (long long)collective.count * sizeof(int);
+					result.iterations = iterations;
+					result.errors = totalErrors;
+					result.minimum = percentile(slowestTimes, 0);
+					result.median = percentile(slowestTimes, 0.5);
+					result.p99 = percentile(slowestTimes, 0.99);
+					result.maximum = percentile(slowestTimes, 1);
+					writeResult(out, json, result);
+				}
+
+				// doubling past the largest int would wrap around
+				if (currentSize > maximumSize / 2)
+				{
+					break;
+				}
+			}
+		}
+
+		MPI_Comm_free(&collective.comm);
+	}
+
+	MPI_Finalize();
+}
+
+void printUsage()
+{
+	cout << "Usage: mpiexec -n <number of processes> ./collectives [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  -sizes <min> <max>    bytes per process, doubling from min up to max (default " << sizeof(int) << " " << MAX_SIZE << ")" << endl;
+	cout << "  -iterations <n>       timed calls at every size (default " << ITERATIONS << ")" << endl;
+	cout << "  -warmup <n>           calls before the timed ones that don't count (default " << WARMUP << ")" << endl;
+	cout << "  -operations <a,b,...> only these: bcast, reduce, allreduce, butterfly, gather, gatherv," << endl;
+	cout << "                        scatter, scatterv, alltoall (default all)" << endl;
+	cout << "  -format csv|json      one CSV row or one JSON object per line (default csv)" << endl;
+	cout << "  -output <file>        write the results to a file instead of the screen" << endl;
+	cout << "  -globalClock          time from the first process in to the last one out on synced clocks" << endl;
+}
+
+// whether name is one of the comma separated names in operationList
+bool operationSelected(const char* operationList, const char* name)
+{
+	size_t length = strlen(name);
+	for (const char* entry = operationList; entry != NULL; entry = strchr(entry, ','))
+	{
+		if (*entry == ',')
+		{
+			entry++;
+		}
+		if (strncmp(entry, name, length) == 0 && (entry[length] == ',' || entry[length] == '\0'))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+	Fills the buffers for an operation.  Every process sends its rank + 1
+	everywhere, except that the root of a broadcast has its ones in the
+	receive buffer, which is where MPI_Bcast sends from.  The receive
+	buffers start at 0 so nothing is right by accident.
+*/
+void prepare(Collective& collective, int operation)
+{
+	int count = collective.count;
+	int processes = collective.commSize;
+
+	collective.counts.resize(processes);
+	collective.displacements.resize(processes);
+	int offset = 0;
+	for (int rank = 0; rank < processes; rank++)
+	{
+		collective.counts[rank] = (rank % 2 == 0) ? max(1, count - count / 2) : count + count / 2;
+		collective.displacements[rank] = offset;
+		offset += collective.counts[rank];
+	}
+
+	long long elements = (long long)processes * (count + count / 2 + 1);
+	fill(collective.sendBuffer, collective.sendBuffer + elements, collective.myRank + 1);
+	fill(collective.receiveBuffer, collective.receiveBuffer + elements, 0);
+
+	if (OPERATIONS[operation].run == broadcast && collective.myRank == 0)
+	{
+		fill(collective.receiveBuffer, collective.receiveBuffer + count, 1);
+	}
+}
+
+/*
+	How many ints of my result are wrong.  Sums are the sum of 1 to the
+	number of processes, gathers and all to all have the block from process
+	j all j + 1, and broadcasts and scatters come from process 0, so all 1.
+*/
+long long check(const Collective& collective, int operation)
+{
+	if (OPERATIONS[operation].result == RESULT_ON_ROOT && collective.myRank != 0)
+	{
+		return 0;
+	}
+
+	CollectiveOperation run = OPERATIONS[operation].run;
+	int count = collective.count;
+	int processes = collective.commSize;
+	const int* result = collective.receiveBuffer;
+
+	long long wrong = 0;
+	if (run == reduce || run == allreduce || run == butterfly)
+	{
+		int sum = processes * (processes + 1) / 2;
+		for (int i = 0; i < count; i++)
+		{
+			wrong += (result[i] != sum) ? 1 : 0;
+		}
+	}
+	else if (run == gather || run == alltoall)
+	{
+		for (int rank = 0; rank < processes; rank++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				wrong += (result[rank * count + i] != rank + 1) ? 1 : 0;
+			}
+		}
+	}
+	else if (run == gatherv)
+	{
+		for (int rank = 0; rank < processes; rank++)
+		{
+			for (int i = 0; i < collective.counts[rank]; i++)
+			{
+				wrong += (result[collective.displacements[rank] + i] != rank + 1) ? 1 : 0;
+			}
+		}
+	}
+	else
+	{
+		int myCount = (run == scatterv) ? collective.counts[collective.myRank] : count;
+		for (int i = 0; i < myCount; i++)
+		{
+			wrong += (result[i] != 1) ? 1 : 0;
+		}
+	}
+	return wrong;
+}
+
+void broadcast(Collective& collective)
+{
+	MPI_Bcast(collective.receiveBuffer, collective.count, MPI_INT, 0, collective.comm);
+}
+
+void reduce(Collective& collective)
+{
+	MPI_Reduce(collective.sendBuffer, collective.receiveBuffer, collective.count, MPI_INT, MPI_SUM, 0, collective.comm);
+}
+
+void allreduce(Collective& collective)
+{
+	MPI_Allreduce(collective.sendBuffer, collective.receiveBuffer, collective.count, MPI_INT, MPI_SUM, collective.comm);
+}
+
+void gather(Collective& collective)
+{
+	MPI_Gather(collective.sendBuffer, collective.count, MPI_INT, collective.receiveBuffer, collective.count, MPI_INT, 0, collective.comm);
+}
+
+void gatherv(Collective& collective)
+{
+	MPI_Gatherv(collective.sendBuffer, collective.counts[collective.myRank], MPI_INT, collective.receiveBuffer,
+		&collective.counts[0], &collective.displacements[0], MPI_INT, 0, collective.comm);
+}
+
+void scatter(Collective& collective)
+{
+	MPI_Scatter(collective.sendBuffer, collective.count, MPI_INT, collective.receiveBuffer, collective.count, MPI_INT, 0, collective.comm);
+}
+
+void scatterv(Collective& collective)
+{
+	MPI_Scatterv(collective.sendBuffer, &collective.counts[0], &collective.displacements[0], MPI_INT, collective.receiveBuffer,
+		collective.counts[collective.myRank], MPI_INT, 0, collective.comm);
+}
+
+void alltoall(Collective& collective)
+{
+	MPI_Alltoall(collective.sendBuffer, collective.count, MPI_INT, collective.receiveBuffer, collective.count, MPI_INT, collective.comm);
+}
+
+/*
+	The butterfly from mpi_allreduce.c.  At step s my partner is the rank
+	that differs from mine in bit s, we swap partial sums and both add them
+	up, so after log2(processes) steps everybody has the whole sum.  The
+	partner's part goes into the upper half of the receive buffer, which the
+	result doesn't use.
+*/
+void butterfly(Collective& collective)
+{
+	int count = collective.count;
+	int* sum = collective.receiveBuffer;
+	int* partnerSum = collective.receiveBuffer + count;
+
+	memcpy(sum, collective.sendBuffer, count * sizeof(int));
+
+	for (int distance = 1; distance < collective.commSize; distance *= 2)
+	{
+		int partner = collective.myRank ^ distance;
+		MPI_Sendrecv(sum, count, MPI_INT, partner, 0, partnerSum, count, MPI_INT, partner, 0, collective.comm, MPI_STATUS_IGNORE);
+
+		for (int i = 0; i < count; i++)
+		{
+			sum[i] += partnerSum[i];
+		}
+	}
+}
+
+/*
+	Nearest rank percentile: the smallest time that at least fraction of the
+	times are less than or equal to.
+*/
+double percentile(const vector<double>& sortedTimes, double fraction)
+{
+	if (sortedTimes.empty())
+	{
+		return 0;
+	}
+
+	int rank = (int)ceil(fraction * sortedTimes.size()) - 1;
+	return sortedTimes[max(0, min(rank, (int)sortedTimes.size() - 1))];
+}
+
+void writeHeader(ostream& out, bool json)
+{
+	if (!json)
+	{
+		out << "operation,processes,bytes,iterations,wrong_elements,min_us,median_us,p99_us,max_us" << endl;
+	}
+}
+
+// times in microseconds, each the slowest process of an iteration
+void writeResult(ostream& out, bool json, const CollectiveResult& result)
+{
+	out << fixed << setprecision(3);
+	if (json)
+	{
+		out << "{\"operation\": \"" << result.operation << "\", \"processes\": " << result.processes << ", \"bytes\": " << result.bytes
+			<< ", \"iterations\": " << result.iterations << ", \"wrong_elements\": " << result.errors << ", \"min_us\": " << result.minimum * 1e6
+			<< ", \"median_us\": " << result.median * 1e6 << ", \"p99_us\": " << result.p99 * 1e6 << ", \"max_us\": " << result.maximum * 1e6 << "}" << endl;
+	}
+	else
+	{
+		out << result.operation << "," << result.processes << "," << result.bytes << "," << result.iterations << "," << result.errors << ","
+			<< result.minimum * 1e6 << "," << result.median * 1e6 << "," << result.p99 * 1e6 << "," << result.maximum * 1e6 << endl;
+	}
+}
@@ -0,0 +1,562 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "hashlife.h"
+
+/*
+This is the HashLife engine for the Game of Life, for runs that ask for
+millions of generations of patterns that repeat themselves a lot.  The board
+is a quadtree of hash-consed nodes and advancing a node is memoized, so a
+region that looks like one we already did costs a single lookup.  A step
+advances 2^k generations at once, and the gap between two printed generations
+is done as one step per set bit.
+
+The direct engine plays on a board that wraps around, and so does this one.
+When rows and columns are both powers of two the board gets tiled across a
+bigger square, and because the tiling lines up with the quadtree every copy
+is the same node, so a step can be any length.  Other board sizes are
+repeated across a square at least twice as big as the board, which
+successor takes at most a quarter of that square forward, and the middle
+of the result, which holds every cell of the board at least once, is folded
+back onto the board (stepFolded).  Then the square is built again for the
+next step.
+
+Any radius 1 rule without B0 works (-rule), the 4x4 base case reads it from
+the same 18 bit table the direct engine uses.
+
+The node pool is garbage collected between steps when it is more than half
+full, keeping only the nodes the board still uses.  The limit (-hashNodes)
+holds during a step too: once the pool is full successor stops making new
+results, the step is thrown away, and it is done again after collecting
+the garbage, in halves if it still doesn't fit.  A board that can't even
+take one generation at a time in the pool ends the run with an error.
+*/
+
+using namespace std;
+
+HashLifeUniverse::HashLifeUniverse(long long maxNodes, unsigned int mooreRuleTable)
+{
+	maxNodeCount = maxNodes;
+	ruleTable = mooreRuleTable;
+	full = false;
+
+	// the two level 0 nodes, a dead cell and an alive one
+	HashLifeNode deadCell = { -1, -1, -1, -1, 0, 0 };
+	HashLifeNode aliveCell = { -1, -1, -1, -1, 0, 1 };
+	nodes.push_back(deadCell);
+	nodes.push_back(aliveCell);
+}
+
+int HashLifeUniverse::join(int nw, int ne, int sw, int se)
+{
+	HashLifeKey key = { nw, ne, sw, se };
+
+	unordered_map<HashLifeKey, int, HashLifeKeyHash>::iterator found = nodeCache.find(key);
+	if (found != nodeCache.end())
+	{
+		return found->second;
+	}
+
+	HashLifeNode newNode;
+	newNode.nw = nw;
+	newNode.ne = ne;
+	newNode.sw = sw;
+	newNode.se = se;
+	newNode.level = nodes[nw].level + 1;
+	newNode.population = nodes[nw].population + nodes[ne].population + nodes[sw].population + nodes[se].population;
+
+	int index = nodes.size();
+	nodes.push_back(newNode);
+	nodeCache[key] = index;
+
+	if ((long long)nodes.size() >= maxNodeCount)
+	{
+		full = true;
+	}
+
+	return index;
+}
+
+int HashLifeUniverse::emptyNode(int level)
+{
+	if (emptyNodes.empty())
+	{
+		emptyNodes.push_back(cell(0));
+	}
+
+	while ((int)emptyNodes.size() <= level)
+	{
+		int smaller = emptyNodes.back();
+		emptyNodes.push_back(join(smaller, smaller, smaller, smaller));
+	}
+
+	return emptyNodes[level];
+}
+
+int HashLifeUniverse::centre(int node)
+{
+	const HashLifeNode& square = nodes[node];
+	return join(nodes[square.nw].se, nodes[square.ne].sw, nodes[square.sw].ne, nodes[square.se].nw);
+}
+
+/*
+	Brute force for a 4x4 square: one generation of the 2x2 cells in the middle.
+*/
+int HashLifeUniverse::levelTwoSuccessor(int node)
+{
+	int cells[4][4];
+	const HashLifeNode& square = nodes[node];
+	int quadrants[4] = { square.nw, square.ne, square.sw, square.se };
+
+	for (int quadrant = 0; quadrant < 4; quadrant++)
+	{
+		const HashLifeNode& small = nodes[quadrants[quadrant]];
+		int rowOffset = (quadrant / 2) * 2;
+		int columnOffset = (quadrant % 2) * 2;
+
+		cells[rowOffset][columnOffset] = nodes[small.nw].population;
+		cells[rowOffset][columnOffset + 1] = nodes[small.ne].population;
+		cells[rowOffset + 1][columnOffset] = nodes[small.sw].population;
+		cells[rowOffset + 1][columnOffset + 1] = nodes[small.se].population;
+	}
+
+	int result[4];
+	for (int row = 1; row <= 2; row++)
+	{
+		for (int column = 1; column <= 2; column++)
+		{
+			int aliveCounter = 0;
+			for (int rowOffset = -1; rowOffset <= 1; rowOffset++)
+			{
+				for (int columnOffset = -1; columnOffset <= 1; columnOffset++)
+				{
+					if (rowOffset != 0 || columnOffset != 0)
+					{
+						aliveCounter += cells[row + rowOffset][column + columnOffset];
+					}
+				}
+			}
+
+			//rules governing life and death
+			int alive = (ruleTable >> (cells[row][column] * 9 + aliveCounter)) & 1;
+
+			result[(row - 1) * 2 + (column - 1)] = alive;
+		}
+	}
+
+	return join(cell(result[0]), cell(result[1]), cell(result[2]), cell(result[3]));
+}
+
+int HashLifeUniverse::successor(int node, int stepExponent)
+{
+	// the step is going to be thrown away, so no more work on it
+	if (full)
+	{
+		return node;
+	}
+
+	const HashLifeNode square = nodes[node];
+
+	if (square.population == 0)
+	{
+		return emptyNode(square.level - 1);
+	}
+
+	long long key = (long long)node * 64 + stepExponent;
+	unordered_map<long long, int>::iterator found = resultCache.find(key);
+	if (found != resultCache.end())
+	{
+		return found->second;
+	}
+
+	int result;
+
+	if (square.level == 2)
+	{
+		result = levelTwoSuccessor(node);
+	}
+	else
+	{
+		const HashLifeNode nw = nodes[square.nw];
+		const HashLifeNode ne = nodes[square.ne];
+		const HashLifeNode sw = nodes[square.sw];
+		const HashLifeNode se = nodes[square.se];
+
+		// the nine overlapping level n-1 squares
+		int pieces[9];
+		pieces[0] = square.nw;
+		pieces[1] = join(nw.ne, ne.nw, nw.se, ne.sw);
+		pieces[2] = square.ne;
+		pieces[3] = join(nw.sw, nw.se, sw.nw, sw.ne);
+		pieces[4] = join(nw.se, ne.sw, sw.ne, se.nw);
+		pieces[5] = join(ne.sw, ne.se, se.nw, se.ne);
+		pieces[6] = square.sw;
+		pieces[7] = join(sw.ne, se.nw, sw.se, se.sw);
+		pieces[8] = square.se;
+
+		bool fullSpeed = stepExponent == square.level - 2;
+
+		// at full speed both halves of the step move 2^(n-3) generations,
+		// otherwise the first half just takes the middle and the second half
+		// does the whole step
+		for (int piece = 0; piece < 9; piece++)
+		{
+			pieces[piece] = fullSpeed ? successor(pieces[piece], square.level - 3) : centre(pieces[piece]);
+		}
+		if (full)
+		{
+			return node;
+		}
+
+		int secondExponent = fullSpeed ? square.level - 3 : stepExponent;
+
+		int resultNw = successor(join(pieces[0], pieces[1], pieces[3], pieces[4]), secondExponent);
+		int resultNe = successor(join(pieces[1], pieces[2], pieces[4], pieces[5]), secondExponent);
+		int resultSw = successor(join(pieces[3], pieces[4], pieces[6], pieces[7]), secondExponent);
+		int resultSe = successor(join(pieces[4], pieces[5], pieces[7], pieces[8]), secondExponent);
+		if (full)
+		{
+			return node;
+		}
+
+		result = join(resultNw, resultNe, resultSw, resultSe);
+	}
+
+	resultCache[key] = result;
+
+	return result;
+}
+
+void HashLifeUniverse::collectGarbage(vector<int*>& roots)
+{
+	if ((long long)nodes.size() <= maxNodeCount / 2 && !full)
+	{
+		return;
+	}
+	full = false;
+
+	vector<char> reachable(nodes.size(), 0);
+	vector<int> stack;
+
+	reachable[0] = 1;
+	reachable[1] = 1;
+	for (size_t root = 0; root < roots.size(); root++)
+	{
+		stack.push_back(*roots[root]);
+	}
+
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		if (reachable[index])
+		{
+			continue;
+		}
+		reachable[index] = 1;
+
+		const HashLifeNode& square = nodes[index];
+		stack.push_back(square.nw);
+		stack.push_back(square.ne);
+		stack.push_back(square.sw);
+		stack.push_back(square.se);
+	}
+
+	// children are always older than their parents, so walking the pool in
+	// order renumbers the children first
+	vector<int> newIndex(nodes.size(), -1);
+	vector<HashLifeNode> keptNodes;
+	nodeCache.clear();
+
+	for (size_t index = 0; index < nodes.size(); index++)
+	{
+		if (!reachable[index])
+		{
+			continue;
+		}
+
+		HashLifeNode square = nodes[index];
+		if (square.level > 0)
+		{
+			square.nw = newIndex[square.nw];
+			square.ne = newIndex[square.ne];
+			square.sw = newIndex[square.sw];
+			square.se = newIndex[square.se];
+
+			HashLifeKey key = { square.nw, square.ne, square.sw, square.se };
+			nodeCache[key] = keptNodes.size();
+		}
+
+		newIndex[index] = keptNodes.size();
+		keptNodes.push_back(square);
+	}
+
+	nodes.swap(keptNodes);
+	resultCache.clear();
+	emptyNodes.clear();
+
+	for (size_t root = 0; root < roots.size(); root++)
+	{
+		*roots[root] = newIndex[*roots[root]];
+	}
+}
+
+/*
+	Builds the 2^level square whose top left corner is cell (row, column) of
+	the board, with cells past the edge of the board repeating it.  Once the
+	node pool is full it gives up, and what comes back is meaningless.
+*/
+static int buildNode(HashLifeUniverse& universe, const vector<char>& board, int rows, int columns, long long row, long long column, int level)
+{
+	if (level == 0 || universe.outOfNodes())
+	{
+		return universe.cell(board[(long long)(row % rows) * columns + (column % columns)]);
+	}
+
+	long long half = 1LL << (level - 1);
+
+	int nw = buildNode(universe, board, rows, columns, row, column, level - 1);
+	int ne = buildNode(universe, board, rows, columns, row, column + half, level - 1);
+	int sw = buildNode(universe, board, rows, columns, row + half, column, level - 1);
+	int se = buildNode(universe, board, rows, columns, row + half, column + half, level - 1);
+
+	return universe.join(nw, ne, sw, se);
+}
+
+/*
+	Copies the live cells of a node whose top left corner sits at (row, column)
+	into the rows x columns window of the board.
+*/
+static void writeCells(const HashLifeUniverse& universe, int node, long long row, long long column, vector<char>& board, int rows, int columns)
+{
+	const HashLifeNode& square = universe.node(node);
+	long long size = 1LL << square.level;
+
+	if (square.population == 0 || row >= rows || column >= columns || row + size <= 0 || column + size <= 0)
+	{
+		return;
+	}
+
+	if (square.level == 0)
+	{
+		board[(long long)row * columns + column] = 1;
+		return;
+	}
+
+	long long half = size / 2;
+	writeCells(universe, square.nw, row, column, board, rows, columns);
+	writeCells(universe, square.ne, row, column + half, board, rows, columns);
+	writeCells(universe, square.sw, row + half, column, board, rows, columns);
+	writeCells(universe, square.se, row + half, column + half, board, rows, columns);
+}
+
+/*
+	Sets the live cells of a node whose top left corner sits at (row, column)
+	of the wrapped board, every copy of the board it covers landing on the
+	same cells.
+*/
+static void foldCells(const HashLifeUniverse& universe, int node, long long row, long long column, vector<char>& board, int rows, int columns)
+{
+	const HashLifeNode& square = universe.node(node);
+
+	if (square.population == 0)
+	{
+		return;
+	}
+
+	if (square.level == 0)
+	{
+		board[(row % rows) * columns + column % columns] = 1;
+		return;
+	}
+
+	long long half = 1LL << (square.level - 1);
+	foldCells(universe, square.nw, row, column, board, rows, columns);
+	foldCells(universe, square.ne, row, column + half, board, rows, columns);
+	foldCells(universe, square.sw, row + half, column, board, rows, columns);
+	foldCells(universe, square.se, row + half, column + half, board, rows, columns);
+}
+
+static bool isPowerOfTwo(int x)
+{
+	return x > 0 && (x & (x - 1)) == 0;
+}
+
+static int levelFor(long long size)
+{
+	int level = 0;
+	while ((1LL << level) < size)
+	{
+		level++;
+	}
+	return level;
+}
+
+/*
+	One step of 2^stepExponent generations on the wrapped board.  The board is
+	a level s node, tiled into a big enough square, and the middle of the
+	result is the board again, shifted by half of the big square.
+*/
+static int stepWrapped(HashLifeUniverse& universe, int board, int stepExponent)
+{
+	int boardLevel = universe.node(board).level;
+	int level = max(boardLevel + 1, stepExponent + 2);
+
+	int tiled = board;
+	for (int tileLevel = boardLevel; tileLevel < level; tileLevel++)
+	{
+		tiled = universe.join(tiled, tiled, tiled, tiled);
+	}
+
+	int result = universe.successor(tiled, stepExponent);
+
+	if (level - 2 >= boardLevel)
+	{
+		// shifted by a whole number of boards, any aligned board-sized piece will do
+		while (universe.node(result).level > boardLevel)
+		{
+			result = universe.node(result).nw;
+		}
+		return result;
+	}
+
+	// shifted by half a board, so the quadrants trade places
+	const HashLifeNode& shifted = universe.node(result);
+	return universe.join(shifted.se, shifted.sw, shifted.ne, shifted.nw);
+}
+
+/*
+	One step of 2^stepExponent generations of a board of any size, kept in
+	board.  The board repeated across a level square becomes the middle half
+	of that square 2^stepExponent generations later, every cell of it a cell
+	of the board, so the live ones are set again where they land modulo the
+	board.  stepExponent can be at most level - 2.  The board stays as it was
+	if the node pool filled up.
+*/
+static void stepFolded(HashLifeUniverse& universe, vector<char>& board, int rows, int columns, int level, int stepExponent)
+{
+	int square = buildNode(universe, board, rows, columns, 0, 0, level);
+	int result = universe.successor(square, stepExponent);
+	if (universe.outOfNodes())
+	{
+		return;
+	}
+
+	long long quarter = 1LL << (level - 2);
+	fill(board.begin(), board.end(), 0);
+	foldCells(universe, result, quarter, quarter, board, rows, columns);
+}
+
+// an empty square has to stay empty, or the memoized empty nodes are wrong
+bool hashLifeSupports(const LifeRule& rule)
+{
+	return rule.radius == 1 && !(rule.birthMask & 1);
+}
+
+bool runHashLife(const vector<char>& board, int rows, int columns, int startGeneration, int iterations, int printIteration, long long maxNodes, const LifeRule& rule)
+{
+	HashLifeUniverse universe(maxNodes, mooreTable(rule.birthMask, rule.survivalMask));
+
+	// a power of two board is kept as a node, any other as cells
+	bool tiled = isPowerOfTwo(rows) && isPowerOfTwo(columns);
+	int level = levelFor(max(rows, columns));
+
+	// the folded steps need the middle half of the square to hold the board
+	int foldLevel = max(level + 1, 2);
+	int largestStep = tiled ? 62 : foldLevel - 2;
+
+	int root = tiled ? buildNode(universe, board, rows, columns, 0, 0, level) : universe.cell(0);
+	vector<char> current(board);
+	long long generation = startGeneration;
+
+	vector<char> frame(board.size());
+	vector<int*> roots;
+	if (tiled)
+	{
+		roots.push_back(&root);
+	}
+	if (universe.outOfNodes())
+	{
+		cerr << "hashlife: " << maxNodes << " nodes are too few for this board, use a bigger -hashNodes" << endl;
+		return false;
+	}
+	bool retrying = false;
+
+	// the direct engine prints after generation counter + 1 when counter % k == 0
+	long long firstPrinted = ((startGeneration + printIteration - 1) / printIteration) * (long long)printIteration;
+	for (long long counter = firstPrinted; counter < iterations; counter += printIteration)
+	{
+		long long gap = counter + 1 - generation;
+
+		// the biggest steps that fit in the gap, the folded ones no bigger than
+		// the square allows
+		while (gap > 0)
+		{
+			int stepExponent = min(largestStep, 62);
+			while ((1LL << stepExponent) > gap)
+			{
+				stepExponent--;
+			}
+
+			int next = root;
+			if (tiled)
+			{
+				next = stepWrapped(universe, root, stepExponent);
+			}
+			else
+			{
+				stepFolded(universe, current, rows, columns, foldLevel, stepExponent);
+			}
+
+			// a step that filled the pool gets another go in an empty one, and
+			// if that fills up too the steps get halved from here on
+			bool filled = universe.outOfNodes();
+			if (!filled)
+			{
+				root = next;
+			}
+			universe.collectGarbage(roots);
+			if (filled)
+			{
+				if (retrying && stepExponent == 0)
+				{
+					cerr << "hashlife: " << maxNodes << " nodes are too few for this board, use a bigger -hashNodes" << endl;
+					return false;
+				}
+				if (retrying)
+				{
+					largestStep = stepExponent - 1;
+				}
+				retrying = true;
+				continue;
+			}
+
+			retrying = false;
+			gap -= 1LL << stepExponent;
+		}
+		generation = counter + 1;
+
+		if (tiled)
+		{
+			fill(frame.begin(), frame.end(), 0);
+			writeCells(universe, root, 0, 0, frame, rows, columns);
+		}
+		else
+		{
+			frame = current;
+		}
+
+		cout << endl;
+		for (int row = 0; row < rows; row++)
+		{
+			for (int column = 0; column < columns; column++)
+			{
+				cout << (int)frame[(long long)row * columns + column];
+			}
+			cout << endl;
+		}
+	}
+
+	return true;
+}
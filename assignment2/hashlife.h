@@ -0,0 +1,100 @@
+#ifndef BK_HASHLIFE_H
+#define BK_HASHLIFE_H
+
+#include <vector>
+#include <unordered_map>
+#include "life_rules.h"
+
+/*
+	HashLife engine for the Game of Life.  The board is a quadtree where every
+	node is hash-consed, so equal squares are stored once, and the result of
+	advancing a node is memoized.  A level n node is a 2^n x 2^n square, level 0
+	nodes are single cells.
+*/
+
+struct HashLifeNode
+{
+	int nw, ne, sw, se;
+	int level;
+	long long population;
+};
+
+struct HashLifeKey
+{
+	int nw, ne, sw, se;
+
+	bool operator==(const HashLifeKey& other) const
+	{
+		return nw == other.nw && ne == other.ne && sw == other.sw && se == other.se;
+	}
+};
+
+struct HashLifeKeyHash
+{
+	size_t operator()(const HashLifeKey& key) const
+	{
+		size_t hash = (size_t)key.nw * 0x9E3779B97F4A7C15ULL;
+		hash = (hash ^ (size_t)key.ne) * 0xC2B2AE3D27D4EB4FULL;
+		hash = (hash ^ (size_t)key.sw) * 0x165667B19E3779F9ULL;
+		hash = (hash ^ (size_t)key.se) * 0x9E3779B97F4A7C15ULL;
+		return hash ^ (hash >> 29);
+	}
+};
+
+class HashLifeUniverse
+{
+public:
+	// the node pool never grows much past maxNodes, a step that would fill it
+	// stops early and says so with outOfNodes.  mooreRuleTable is the rule,
+	// see mooreTable in life_rules.h
+	HashLifeUniverse(long long maxNodes, unsigned int mooreRuleTable);
+
+	// index of the dead or the alive level 0 node
+	int cell(int alive) const { return alive ? 1 : 0; }
+
+	int join(int nw, int ne, int sw, int se);
+	int emptyNode(int level);
+
+	// the level n-1 square in the middle of a level n node
+	int centre(int node);
+
+	// the middle level n-1 square of a level n node, 2^stepExponent generations
+	// later.  stepExponent can be at most n - 2.  Once the pool is full the
+	// result is meaningless and has to be thrown away.
+	int successor(int node, int stepExponent);
+
+	// true from the time the pool fills up to the next collectGarbage
+	bool outOfNodes() const { return full; }
+
+	const HashLifeNode& node(int index) const { return nodes[index]; }
+	long long nodeCount() const { return nodes.size(); }
+
+	// drops every node that is not reachable from the given roots and all
+	// memoized results when the pool is more than half full.  The roots are
+	// updated to their new indices.
+	void collectGarbage(std::vector<int*>& roots);
+
+private:
+	int levelTwoSuccessor(int node);
+
+	long long maxNodeCount;
+	unsigned int ruleTable;
+	bool full;
+
+	std::vector<HashLifeNode> nodes;
+	std::unordered_map<HashLifeKey, int, HashLifeKeyHash> nodeCache;
+	// key is node * 64 + stepExponent
+	std::unordered_map<long long, int> resultCache;
+	std::vector<int> emptyNodes;
+};
+
+// radius 1 without B0, the rules runHashLife can run
+bool hashLifeSupports(const LifeRule& rule);
+
+// runs the whole simulation on this rank with HashLife and prints the same
+// frames as the direct engine.  board holds rows * columns cells at
+// generation startGeneration, and the rule has to be one hashLifeSupports.
+// Returns false if maxNodes is too few for even a one generation step.
+bool runHashLife(const std::vector<char>& board, int rows, int columns, int startGeneration, int iterations, int printIteration, long long maxNodes, const LifeRule& rule);
+
+#endif
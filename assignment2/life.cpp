@@ -5,9 +5,20 @@
 #include <mpi.h>
 #include <ctime>
 #include "life.h"
+#include "hashlife.h"
+#include "life_io.h"
+#include "life_rules.h"
+#include "life_simd.h"
+#include "life_node.h"
+#include "clock_sync.h"
 #include <cmath>
 #include <algorithm>
 #include <cstring>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <climits>
+#include <unistd.h>
 
 /*
 This program is a parallel implementation of Conway’s Game of Life.  
@@ -20,6 +31,93 @@ The algorithm is described pretty in depth in my Homework 3 submission which
 I have also included in this submission.  Essentially what the main algorithm 
 is is a for loop that goes through each row and checks the 8 cells around and 
 counts to see whether or not they are alive.  
+
+Each rank is a hybrid MPI+OpenMP process.  The rows of a rank's block are split
+among OpenMP threads (set the thread count with OMP_NUM_THREADS), and all MPI
+calls stay on the main thread (MPI_THREAD_FUNNELED).  The halo rows are posted
+with MPI_Isend/MPI_Irecv first, the threads update the interior rows while the
+messages are in flight, and only the first and last row of the block wait for
+the halo to arrive.  That way we can run one rank per socket instead of one
+rank per core.
+
+Each block is also cut into tiles (TILE_ROWS x TILE_COLUMNS in life.h), and a
+tile is only recomputed when it or one of its neighbor tiles changed in the last
+generation.  A boundary row that did not change is sent as an empty message,
+so a board that has mostly settled down costs about as much as the part of it
+that is still moving.
+
+For very long runs there is also a HashLife engine (-engine hashlife, see
+hashlife.cpp) that takes the same parameters and prints the same frames.
+
+Instead of random cells the board can start from an RLE or plaintext pattern
+(-pattern) or from a snapshot of an earlier run (-restart).  Snapshots are
+written every few generations with -snapshot, see life_io.cpp.  With -frames
+the printed generations go to PBM files in the background instead of being
+gathered on rank 0 and printed.
+
+The rows are split as evenly as they go to start with.  With -balance every
+rank times its compute, and every few generations the block boundaries move
+towards where the live cells are, with the rows migrating between neighbors.
+
+The rule does not have to be Conway's.  -rule takes B3/S23 style rules, a few
+names, and Larger than Life rules with a bigger neighborhood, see
+life_rules.cpp.  A rule with radius r gets r ghost rows on each side, and the
+common rules get their own compiled copy of the kernel.
+
+A random board is no longer made on rank 0 and broadcast.  Every rank fills
+its own rows with a counter-based random number generator (Philox) keyed on
+the seed (-seed) and the cell's place on the board, so the number of living
+cells on the command line is how many are alive on average, and a seed gives
+the same board no matter how many processes there are.
+
+Cells are one byte each.  Radius 1 rules run on SSE2, AVX2 or AVX-512 vector
+kernels (life_simd.cpp), whichever is the widest one the CPU has, so the same
+binary runs on every node of a cluster with different CPUs (-kernel picks one
+by hand).
+
+Lots of runs end up as still lifes and blinkers long before they run out of
+generations.  With -detectCycles every generation gets a 64 bit fingerprint,
+the sum of a hash of every live cell's place on the board, added up over the
+ranks with MPI_Allreduce.  When a fingerprint shows up again within the last n
+generations the board is repeating with that period, and the run jumps ahead
+by whole periods, but never past the next generation that gets printed,
+snapshotted or rebalanced (wantedGeneration), so every frame and snapshot of
+a full run still gets written.  After that it keeps going and jumps again.
+
+For when only the numbers matter there is -stats, a CSV line per generation
+with the live cells, births, deaths and the bounding box of the live cells.
+Every tile keeps its own numbers up to date when it gets recomputed, the
+ranks add theirs up with one MPI_Ireduce, and rank 0 writes the line out
+during the next generation.  With -detectCycles too, rank 0 keeps the last n
+lines, and the lines of the generations a jump skips are the ones a period
+earlier with the generation changed, so the file still has every generation.
+
+Ranks on the same node keep their grids in MPI shared memory windows
+(MPI_Win_allocate_shared on the MPI_Comm_split_type node communicator), laid
+out so that a rank's ghost rows are its node neighbor's rows themselves.
+Only the neighbors on other nodes get halo messages, see life_node.cpp.
+
+Boards can have more than 2^31 cells.  Rows and columns still fit in an int
+each, but everything that multiplies them (offsets into a block, file
+offsets, the number of living cells) is 64 bit, and MPI messages and file
+reads and writes use a datatype of one whole row so their int counts are
+rows instead of cells.
+
+-timing adds up, on every rank, the time spent computing, waiting for the
+halo, waiting in the barrier at the end of a generation and writing output,
+and prints the min, avg and max over the ranks at the end.  It also syncs the
+clocks (clock_sync.cpp) before and after the run and prints when every rank
+started and finished on rank 0's clock.  -scaling runs the whole thing on 1,
+2, 4, ... ranks (runSimulation takes the communicator to run on) for a strong
+or weak scaling curve in a CSV file.
+
+With -temporal d the halo is d generations deep and gets exchanged every d
+generations.  In between, the block is cut into bands of rows that fit in L2
+and each band is taken d generations forward before moving on to the next,
+skewed so the two grids are enough (see advanceGenerations).  The cells get
+read from memory once per d generations instead of every generation.  Tiles
+are not skipped in this mode, and -stats and -detectCycles turn it off since
+they need every generation.
 */
 
 using namespace std;
@@ -31,606 +129,1826 @@ int main(int argc, char *argv[])
 
 	const int MAX_STRING = 100;
 
-	int m, n, j, i, k;
+	int m, n, j, k;
+	long long i;
 
 	// alias to these pointers because I don't feel like remember single characters
 	const int& rows = m;
 	const int& columns = n;
 	const int& iterations = j;
-	const int& originalLivingCells = i;
+	const long long& originalLivingCells = i;
 	const int& printIteration = k;
 
 	if (argc < 6)
 	{
-		cout << "Usage: mpiexec -n <number of processes> ./life <number of living cells> <number of iterations> <number of iterations to print on> <number of rows> <number of columns>" << endl;
+		printUsage();
 		exit(1);
 	}
 
-	i = atoi(argv[1]);
+	i = atoll(argv[1]);
 	j = atoi(argv[2]);
 	k = atoi(argv[3]);
-	m = atoi(argv[4]);
-	n = atoi(argv[5]);
-
-	int* aliveArray = new int[originalLivingCells];
-
-	MPI_Init(NULL, NULL);
-	MPI_Comm_size(MPI_COMM_WORLD, &commSize);
-	MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
 
-	if (myRank == 0)
+	// a side of the board is a count of rows or of cells in a row type, so
+	// each one has to fit in an int, the board itself can be bigger
+	long long rowArgument = atoll(argv[4]);
+	long long columnArgument = atoll(argv[5]);
+	if (rowArgument < 1 || rowArgument > INT_MAX || columnArgument < 1 || columnArgument > INT_MAX)
 	{
-		generateAlive(aliveArray, originalLivingCells, rows, columns);
+		cout << "The rows and columns have to be between 1 and " << INT_MAX << endl;
+		exit(1);
 	}
+	m = rowArgument;
+	n = columnArgument;
 
-	MPI_Bcast(aliveArray, originalLivingCells, MPI_INT, 0, MPI_COMM_WORLD);
+	// optional flags after the five numbers
+	bool useHashLife = false;
+	long long hashLifeNodes = 1LL << 22;
+	const char* patternFile = NULL;
+	const char* restartFile = NULL;
+	const char* snapshotPrefix = NULL;
+	int snapshotInterval = 0;
+	int balanceInterval = 0;
+	const char* framePrefix = NULL;
+	const char* ruleText = "B3/S23";
+	long long seed = -1;
+	const char* kernelName = "auto";
+	int cycleWindow = 0;
+	const char* statsFile = NULL;
+	int temporalDepth = 1;
+	bool reportTimes = false;
+	const char* scalingFile = NULL;
+	bool weakScaling = false;
 
-	int rowsPerProcessor = ceil(rows/(double)commSize);
+	for (int argument = 6; argument < argc; argument++)
+	{
+		if (strcmp(argv[argument], "-engine") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			if (strcmp(argv[argument], "hashlife") == 0)
+			{
+				useHashLife = true;
+			}
+			else if (strcmp(argv[argument], "direct") != 0)
+			{
+				printUsage();
+				exit(1);
+			}
+		}
+		else if (strcmp(argv[argument], "-hashNodes") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			hashLifeNodes = atoll(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-pattern") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			patternFile = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-restart") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			restartFile = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-balance") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			balanceInterval = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-frames") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			framePrefix = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-seed") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			seed = atoll(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-kernel") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			kernelName = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-detectCycles") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			cycleWindow = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-stats") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			statsFile = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-temporal") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			temporalDepth = max(1, atoi(argv[argument]));
+		}
+		else if (strcmp(argv[argument], "-timing") == 0)
+		{
+			reportTimes = true;
+		}
+		else if (strcmp(argv[argument], "-scaling") == 0 && argument + 2 < argc
+			&& (strcmp(argv[argument + 1], "strong") == 0 || strcmp(argv[argument + 1], "weak") == 0))
+		{
+			weakScaling = strcmp(argv[argument + 1], "weak") == 0;
+			scalingFile = argv[argument + 2];
+			argument += 2;
+		}
+		else if (strcmp(argv[argument], "-rule") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			ruleText = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-snapshot") == 0 && argument + 2 < argc)
+		{
+			snapshotPrefix = argv[argument + 1];
+			snapshotInterval = atoi(argv[argument + 2]);
+			argument += 2;
+		}
+		else
+		{
+			printUsage();
+			exit(1);
+		}
+	}
 
-	int blockLength = rowsPerProcessor * columns;
+	LifeRule rule;
+	if (!parseRule(ruleText, rule))
+	{
+		cout << "Could not understand the rule " << ruleText << endl;
+		printUsage();
+		exit(1);
+	}
 
-	int* myRows = new int[blockLength];
-	int* rowAbove = new int[blockLength];
-	int* rowBelow = new int[blockLength];
+	if (useHashLife && !hashLifeSupports(rule))
+	{
+		cout << "The hashlife engine only runs radius 1 rules without B0, not " << rule.name << endl;
+		exit(1);
+	}
 
-	// strictly for printing
-	int* printRow = new int[blockLength];
+	if (!selectMooreKernel(kernelName))
+	{
+		cout << "The " << kernelName << " kernel is unknown or this CPU can't run it" << endl;
+		exit(1);
+	}
 
-	fill(myRows, myRows + blockLength, 0);
+	// only the main thread ever talks to MPI
+	int threadSupport;
+	MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &threadSupport);
+	MPI_Comm_size(MPI_COMM_WORLD, &commSize);
+	MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
 
-	fillGrid(myRows, aliveArray, originalLivingCells, myRank, rowsPerProcessor, columns);
+	if (threadSupport < MPI_THREAD_FUNNELED)
+	{
+		if (myRank == 0)
+		{
+			cout << "The MPI library does not support MPI_THREAD_FUNNELED" << endl;
+		}
+		MPI_Finalize();
+		exit(1);
+	}
 
-	MPI_Barrier(MPI_COMM_WORLD);
+	int startGeneration = 0;
 
-	for (int counter = 0; counter < iterations; counter++)
+	// HashLife is a serial engine, rank 0 does the whole board by itself
+	if (useHashLife)
 	{
-		// before I do ANYTHING I need to send my shit.
+		bool finished = true;
+		if (myRank == 0)
+		{
+			vector<unsigned char> cells((size_t)rows * columns, 0);
+			if (setUpBoard(cells.data(), 0, rows, rows, columns, originalLivingCells, seed, patternFile, restartFile, MPI_COMM_SELF, startGeneration))
+			{
+				vector<char> board(cells.begin(), cells.end());
+				finished = runHashLife(board, rows, columns, startGeneration, iterations, printIteration, hashLifeNodes, rule);
+			}
+		}
 
-		int destinationProcessTopRows;
-		int sourceProcessTopRows;
-		int destinationProcessBottomRows;
-		int sourceProcessBottomRows;
+		MPI_Finalize();
+		return finished ? 0 : 1;
+	}
 
+	LifeOptions options;
+	options.rows = rows;
+	options.columns = columns;
+	options.iterations = iterations;
+	options.printIteration = printIteration;
+	options.livingCells = originalLivingCells;
+	options.seed = seed;
+	options.patternFile = patternFile;
+	options.restartFile = restartFile;
+	options.snapshotPrefix = snapshotPrefix;
+	options.snapshotInterval = snapshotInterval;
+	options.balanceInterval = balanceInterval;
+	options.framePrefix = framePrefix;
+	options.cycleWindow = cycleWindow;
+	options.statsFile = statsFile;
+	options.temporalDepth = temporalDepth;
+	options.quiet = false;
+	options.rule = rule;
 
-		if (myRank == 0)
+	if (scalingFile != NULL)
+	{
+		runScaling(options, weakScaling, scalingFile, MPI_COMM_WORLD);
+	}
+	else
+	{
+		// -timing puts every rank's start and end on rank 0's clock, synced
+		// before and after the run so the drift over the run is taken out too
+		ClockSync clock;
+		if (reportTimes)
 		{
-			destinationProcessTopRows = commSize - 1;
+			startClockSync(clock, MPI_COMM_WORLD, CLOCK_SAMPLES);
+		}
 
+		PhaseTimes times;
+		if (!runSimulation(options, MPI_COMM_WORLD, times))
+		{
+			MPI_Finalize();
+			exit(1);
 		}
-		else
+
+		if (reportTimes)
 		{
-			destinationProcessTopRows = myRank - 1;
+			resyncClocks(clock, MPI_COMM_WORLD, CLOCK_SAMPLES);
+			reportTiming(times, clock, MPI_COMM_WORLD);
 		}
+	}
+
+	MPI_Finalize();
+
+
+	return 0;
+}
+
+/*
+	Runs the direct engine on the ranks of comm with the board and the options
+	from the command line, and fills in where my time went.  Returns false,
+	after rank 0 of comm says why, if the board could not be set up.
+*/
+bool runSimulation(const LifeOptions& options, MPI_Comm comm, PhaseTimes& times)
+{
+	int commSize;
+	int myRank;
+	MPI_Comm_size(comm, &commSize);
+	MPI_Comm_rank(comm, &myRank);
 
-		if (myRank == commSize - 1)
+	int rows = options.rows;
+	int columns = options.columns;
+	int iterations = options.iterations;
+	int printIteration = options.printIteration;
+	const char* snapshotPrefix = options.snapshotPrefix;
+	int snapshotInterval = options.snapshotInterval;
+	int balanceInterval = options.balanceInterval;
+	const char* framePrefix = options.framePrefix;
+	int cycleWindow = options.cycleWindow;
+	const char* statsFile = options.statsFile;
+	int temporalDepth = options.temporalDepth;
+	const LifeRule& rule = options.rule;
+
+	int startGeneration = 0;
+
+	// the per generation numbers need every generation
+	if (temporalDepth > 1 && (statsFile != NULL || cycleWindow > 0))
+	{
+		temporalDepth = 1;
+	}
+
+	// a rule with radius r needs r ghost rows on each side for every
+	// generation done between two halo exchanges, and every rank needs at
+	// least that many rows of its own to fill its neighbors' ghost rows
+	int haloDepth = rule.radius * temporalDepth;
+
+	if (rule.radius > TILE_ROWS || rule.radius > TILE_COLUMNS || columns < 2 * rule.radius + 1)
+	{
+		if (myRank == 0)
 		{
-			destinationProcessBottomRows = 0;
+			cout << "The neighborhood of " << rule.name << " is too big for a board with " << columns << " columns" << endl;
 		}
-		else
+		return false;
+	}
+
+	if (rows / commSize < haloDepth)
+	{
+		if (myRank == 0)
 		{
-			destinationProcessBottomRows = myRank + 1;
+			cout << "The board needs at least " << haloDepth << " rows for every process" << endl;
 		}
+		return false;
+	}
+
+	// rank r owns board rows [rowStarts[r], rowStarts[r + 1]).  They start out
+	// as even as they can be and move around when -balance is on.
+	vector<int> rowStarts(commSize + 1);
+	for (int rank = 0; rank <= commSize; rank++)
+	{
+		rowStarts[rank] = BLOCK_LOW(rank, commSize, rows);
+	}
+
+	int firstRow = rowStarts[myRank];
+	int myRowCount = rowStarts[myRank + 1] - firstRow;
+
+	// the board wraps around, so rank 0 and the last rank are neighbors
+	int rankAbove = (myRank == 0) ? commSize - 1 : myRank - 1;
+	int rankBelow = (myRank == commSize - 1) ? 0 : myRank + 1;
+
+	// the ranks on my node share their grids, see life_node.cpp
+	MPI_Comm nodeComm;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myRank, MPI_INFO_NULL, &nodeComm);
+
+	// each grid holds my block plus haloDepth ghost rows above it and below it
+	// for the halo, where the ghost rows can be my node neighbor's own rows.
+	// The next generation is written into the other grid so the threads never
+	// read a cell somebody already updated.
+	NodeGrids nodeGrids;
+	allocateNodeGrids(nodeGrids, comm, nodeComm, myRank, commSize, rankAbove, rankBelow, myRowCount, columns, haloDepth, temporalDepth == 1);
+
+	int currentBuffer = 0;
+	unsigned char* currentGrid = nodeGrids.grids[0];
+	unsigned char* nextGrid = nodeGrids.grids[1];
+
+	// neighbors on my node don't get messages
+	int messageRankAbove = (nodeGrids.flagsAbove != NULL) ? MPI_PROC_NULL : rankAbove;
+	int messageRankBelow = (nodeGrids.flagsBelow != NULL) ? MPI_PROC_NULL : rankBelow;
+
+	// messages carry whole rows and count rows, since a block or even a halo
+	// can be more than INT_MAX cells
+	MPI_Datatype rowType;
+	MPI_Type_contiguous(columns, MPI_UNSIGNED_CHAR, &rowType);
+	MPI_Type_commit(&rowType);
+
+	// strictly for printing
+	vector<unsigned char> printRow;
+
+	unsigned char* myRows = currentGrid + (long long)haloDepth * columns;
+
+	if (!setUpBoard(myRows, firstRow, myRowCount, rows, columns, options.livingCells, options.seed, options.patternFile, options.restartFile, comm, startGeneration))
+	{
+		freeNodeGrids(nodeGrids);
+		MPI_Comm_free(&nodeComm);
+		MPI_Type_free(&rowType);
+		return false;
+	}
+
+	// the block is cut into tiles and only tiles next to a change get recomputed
+	int tileRowCount = (myRowCount + TILE_ROWS - 1) / TILE_ROWS;
+	int tileColumnCount = (columns + TILE_COLUMNS - 1) / TILE_COLUMNS;
+	int tileCount = tileRowCount * tileColumnCount;
+
+	// tile rows from bottomTileRow on touch the bottom haloDepth rows of my block
+	int bottomTileRow = max(0, (myRowCount - haloDepth) / TILE_ROWS);
+
+	// a change reaches the next tile column over, or the one after it when the
+	// last tile column is narrower than the neighborhood and gets jumped over
+	int tileColumnReach = (columns - (tileColumnCount - 1) * TILE_COLUMNS < haloDepth) ? 2 : 1;
+
+	// which tiles changed in the last generation, everything counts as changed at the start
+	vector<char> changedTiles(tileCount, 1);
+	vector<char> nextChangedTiles(tileCount, 0);
+
+	vector<int> activeTiles;
+	activeTiles.reserve(tileCount);
+
+	FrameWriter frameWriter;
+
+	// with -detectCycles every tile keeps a hash of its live cells, and the
+	// sum of them over the board is the fingerprint of a generation
+	vector<unsigned long long> tileHashes(cycleWindow > 0 ? tileCount : 0, 0);
+	deque<unsigned long long> fingerprintHistory;
+
+	// with -stats every tile keeps its live count and bounding box, and the
+	// births and deaths of the generation being computed
+	vector<TileStats> tileStats(statsFile != NULL ? tileCount : 0);
+	long long myStats[STATS_FIELDS];
+	long long boardStats[STATS_FIELDS];
+	deque<vector<long long> > statsHistory;
+	MPI_Request statsRequest = MPI_REQUEST_NULL;
+	MPI_Op statsOp;
+	MPI_Datatype statsType;
+	ofstream statsStream;
+
+	if (statsFile != NULL)
+	{
+		// one generation is one element, so the reduction never splits it up
+		MPI_Type_contiguous(STATS_FIELDS, MPI_LONG_LONG, &statsType);
+		MPI_Type_commit(&statsType);
+		MPI_Op_create(combineStats, 1, &statsOp);
 
 		if (myRank == 0)
 		{
-			sourceProcessTopRows = commSize - 1;
-			sourceProcessBottomRows = myRank + 1;
+			statsStream.open(statsFile);
+			statsStream << "generation,live,births,deaths,min_row,max_row,min_column,max_column" << endl;
 		}
-		else if (myRank == commSize - 1)
+	}
+
+	// -temporal advances bands of rows that fit in L2 several generations at a time
+	int bandRows = temporalBandRows(columns, haloDepth, rule.radius);
+
+	// time spent computing since the last rebalance
+	double computeTime = 0;
+
+	syncNodeGrids(nodeGrids);
+	MPI_Barrier(comm);
+	syncNodeGrids(nodeGrids);
+
+	times = PhaseTimes();
+	double runStart = MPI_Wtime();
+	times.startTime = runStart;
+
+	for (int counter = startGeneration; counter < iterations; counter++)
+	{
+		if (temporalDepth > 1)
 		{
-			sourceProcessTopRows = myRank - 1;
-			sourceProcessBottomRows = 0;
+			// stop early at the next generation somebody wants to see
+			int steps = 1;
+			while (steps < temporalDepth && counter + steps < iterations && !wantedGeneration(counter + steps - 1, startGeneration, printIteration, snapshotInterval, balanceInterval))
+			{
+				steps++;
+			}
+
+			// a deep halo, all of it every time, and then steps generations
+			// without talking to anybody
+			MPI_Request haloRequests[4];
+			MPI_Status haloStatuses[4];
+			double haloStart = MPI_Wtime();
+			exchangeHalo(currentGrid, myRowCount, columns, haloDepth, rowType, messageRankAbove, messageRankBelow, true, true, comm, haloRequests);
+			MPI_Waitall(4, haloRequests, haloStatuses);
+
+			bool haloAboveChanged;
+			bool haloBelowChanged;
+			finishHalo(currentGrid, nextGrid, myRowCount, columns, haloDepth, rowType, haloStatuses, haloAboveChanged, haloBelowChanged);
+			readNodeHalo(nodeGrids, currentBuffer, currentGrid, myRowCount, columns, haloDepth, haloAboveChanged, haloBelowChanged);
+
+			// the second generation goes back into this grid, so my node
+			// neighbors have to be done copying my rows out of it first
+			syncNodeGrids(nodeGrids);
+			MPI_Barrier(nodeComm);
+			syncNodeGrids(nodeGrids);
+			times.seconds[PHASE_HALO] += MPI_Wtime() - haloStart;
+
+			double computeStart = MPI_Wtime();
+			advanceGenerations(currentGrid, nextGrid, steps, myRowCount, columns, haloDepth, bandRows, rule);
+			computeTime += MPI_Wtime() - computeStart;
+			times.seconds[PHASE_COMPUTE] += MPI_Wtime() - computeStart;
+			times.generations += steps;
+
+			if (steps % 2 == 1)
+			{
+				swap(currentGrid, nextGrid);
+				currentBuffer = 1 - currentBuffer;
+			}
+			myRows = currentGrid + (long long)haloDepth * columns;
+			counter += steps - 1;
+
+			publishChanges(nodeGrids, true, true);
 		}
 		else
 		{
-			sourceProcessTopRows = myRank - 1;
-			sourceProcessBottomRows = myRank + 1;
-		}
+			// before I do ANYTHING I need to send my shit.
+			// a boundary row that did not change goes out as an empty message
+			MPI_Request haloRequests[4];
+			MPI_Status haloStatuses[4];
 
-		// Send my top row up
-		MPI_Send(myRows, columns, MPI_INT, destinationProcessTopRows, 0, MPI_COMM_WORLD);
-		// send my bottom row down
-		MPI_Send(myRows + ((rowsPerProcessor - 1) * columns), columns, MPI_INT, destinationProcessBottomRows, 0, MPI_COMM_WORLD);
-		// receive my top row
-		MPI_Recv(rowAbove, columns, MPI_INT, sourceProcessTopRows, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		// receive my bottom row
-		MPI_Recv(rowBelow, columns, MPI_INT, sourceProcessBottomRows, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			bool sendTop = tileRowsChanged(changedTiles.data(), 0, 1, tileColumnCount);
+			bool sendBottom = tileRowsChanged(changedTiles.data(), bottomTileRow, tileRowCount, tileColumnCount);
 
+			exchangeHalo(currentGrid, myRowCount, columns, haloDepth, rowType, messageRankAbove, messageRankBelow, sendTop, sendBottom, comm, haloRequests);
 
-		for (int rowCounter = 0; rowCounter < rowsPerProcessor; rowCounter++)
-		{
-			for (int elementCounter = rowCounter * columns; elementCounter < blockLength; elementCounter++)
+			fill(nextChangedTiles.begin(), nextChangedTiles.end(), 0);
+
+			// tiles that don't get recomputed have nobody born and nobody dying
+			for (int tile = 0; tile < (int)tileStats.size(); tile++)
 			{
-				int aliveCounter = 0;
+				tileStats[tile].births = 0;
+				tileStats[tile].deaths = 0;
+			}
 
+			double computeStart = MPI_Wtime();
 
-				// top row of my block
-				if (rowCounter == 0)
+			// the interior tiles don't need the halo, so do them while it is in flight
+			activeTiles.clear();
+			if (bottomTileRow > 1)
+			{
+				findActiveTiles(changedTiles.data(), tileRowCount, tileColumnCount, tileColumnReach, bottomTileRow, 1, bottomTileRow, false, false, activeTiles);
+				computeTiles(currentGrid, nextGrid, activeTiles, nextChangedTiles.data(), myRowCount, columns, tileColumnCount, haloDepth, rule);
+				if (cycleWindow > 0)
 				{
-					//left
-					//one row per processor
-					if (rowsPerProcessor == 1)
-					{
-						if (elementCounter == 0)
-						{
-							if (rowAbove[0] == 1)
-							{
-							//	cout << "ben" << endl;
-								aliveCounter++;
-							}
-							if (rowAbove[1] == 1)
-							{
-							//	cout << "is " << endl;
-								aliveCounter++;
-							}
-							if (rowAbove[columns - 1] == 1)
-							{
-							//	cout << "awesome" << endl;
-								aliveCounter++;
-							}
-							if (rowBelow[0] == 1)
-							{
-							//	cout << "like" << endl;
-								aliveCounter++;
-							}
-							if (rowBelow[1] == 1)
-							{
-							//	cout << "super" << endl;
-								aliveCounter++;
-							}
-							if (rowBelow[columns - 1] == 1)
-							{
-							//	cout << "crazy" << endl;
-								aliveCounter++;
-							}
-							if (myRows[1] == 1)
-							{
-							//	cout << "brilliantly" << endl;
-								aliveCounter++;
-							}
-							if (myRows[columns - 1]  == 1)
-							{
-							//	cout << "great!" << endl;
-								aliveCounter++;
-							}
-						}
-						else if (elementCounter == columns - 1)
-						{
-							if (myRows[0] == 1)
-							{
-								aliveCounter++;
-							}
-							if (myRows[columns - 2] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowAbove[0] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowAbove[columns - 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowAbove[columns - 2] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[0] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[columns - 2] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[columns - 1] == 1)
-							{
-								aliveCounter++;
-							}
-						}
-						else
-						{
-							if (rowAbove[elementCounter - 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowAbove[elementCounter] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowAbove[elementCounter + 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (myRows[elementCounter - 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (myRows[elementCounter + 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[elementCounter - 1] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[elementCounter] == 1)
-							{
-								aliveCounter++;
-							}
-							if (rowBelow[elementCounter + 1] == 1)
-							{
-								aliveCounter++;
-							}
-						}
-						//cout << "myRank: " << myRank << " " <<  aliveCounter << endl;
-					}
-					else if (rowsPerProcessor > 1)
-					{
-						if (elementCounter % columns == 0)
-						{
-                            if (rowCounter < rowsPerProcessor - 1)
-                            {
-                                if (myRows[(rowCounter + 1) * columns] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[((rowCounter + 1) * columns) + 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[((rowCounter + 1) * columns) + (columns - 1)] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            else if (rowCounter == rowsPerProcessor - 1)
-                            {
-                                if (rowBelow[0] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowBelow[1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowBelow[columns - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            if (myRows[elementCounter + 1] == 1)
-                            {
-                                aliveCounter++;
-                            }
-                            if (myRows[elementCounter + (columns - 1)] == 1)
-                            {
-                                aliveCounter++;
-                            }
-                            if (rowCounter > 0)
-                            {
-                                if (myRows[elementCounter - columns] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[elementCounter - (columns - 1)] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[elementCounter - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            else if (rowCounter == 0)
-                            {
-                                if (rowAbove[0] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[columns - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            // printf("FAMILY/TURKEY WAS FAR MORE IMPORTANT");
-						}
-						else if (elementCounter % columns == columns - 1)
-						{
-                            if (rowCounter < rowsPerProcessor - 1)
-                            {
-                                if (myRows[(rowCounter + 1) * columns] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[((rowCounter + 1) * columns) + columns - 2] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[((rowCounter + 1) * columns) + columns - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            else if (rowCounter == rowsPerProcessor - 1)
-                            {
-                                if (rowBelow[columns - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowBelow[columns - 2] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowBelow[0] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            if (myRows[rowCounter * columns] == 1)
-                            {
-                                aliveCounter++;
-                            }
-                            if (myRows[(rowCounter * columns) + columns - 2] == 1)
-                            {
-                                aliveCounter++;
-                            }
-                            if (rowCounter > 0)
-                            {
-                                if (myRows[(rowCounter - 1) * columns] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[(rowCounter - 1) * columns + (columns - 2)] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (myRows[(rowCounter - 1) * columns + (columns - 1)] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            else if (rowCounter == 0)
-                            {
-                                if (rowAbove[0] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[columns - 2] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[columns - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
+					hashTiles(nextGrid, activeTiles, tileHashes.data(), firstRow, myRowCount, columns, tileColumnCount, haloDepth);
+				}
+				if (statsFile != NULL)
+				{
+					tallyTiles(currentGrid, nextGrid, activeTiles, tileStats.data(), myRowCount, columns, tileColumnCount, haloDepth);
+				}
+			}
 
-						}
-                        // everything but corner of blocks of rows
-						else
-						{
-                            if (rowsPerProcessor == 1)
-                            {
-                                if (rowBelow[elementCounter] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowBelow[elementCounter + 1] == 1)
-                                {
-                                    aliveCounter;
-                                }
-                                if (rowBelow[elementCounter - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[elementCounter] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[elementCounter + 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                                if (rowAbove[elementCounter - 1] == 1)
-                                {
-                                    aliveCounter++;
-                                }
-                            }
-                            else if (rowsPerProcessor > 1)
-                            {
-                                if (rowCounter == 0)
-                                {
-                                    if (rowAbove[elementCounter - 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (rowAbove[elementCounter] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (rowAbove[elementCounter + 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                }
-                                else if (rowCounter > 0)
-                                {
-                                    if (myRows[elementCounter - columns - 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (myRows[elementCounter - columns] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (myRows[elementCounter - columns + 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                }
-                                if (rowCounter < rowsPerProcessor - 1)
-                                {
-                                    if (myRows[elementCounter + columns - 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (myRows[elementCounter + columns] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (myRows[elementCounter + columns + 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                }
-                                else if (rowCounter == rowsPerProcessor - 1)
-                                {
-                                    if (rowBelow[elementCounter % columns] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (rowBelow[(elementCounter % columns) - 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                    if (rowBelow[(elementCounter % columns) + 1] == 1)
-                                    {
-                                        aliveCounter++;
-                                    }
-                                }
-                            }
-
-                            if (myRows[elementCounter + 1] == 1)
-                            {
-                                aliveCounter++;
-                            }
-                            if (myRows[elementCounter - 1] == 1)
-                            {
-                                aliveCounter++;
-                            }
-						}
-					}
+			computeTime += MPI_Wtime() - computeStart;
+			times.seconds[PHASE_COMPUTE] += MPI_Wtime() - computeStart;
+
+			double haloStart = MPI_Wtime();
+			MPI_Waitall(4, haloRequests, haloStatuses);
+
+			bool haloAboveChanged;
+			bool haloBelowChanged;
+			finishHalo(currentGrid, nextGrid, myRowCount, columns, haloDepth, rowType, haloStatuses, haloAboveChanged, haloBelowChanged);
+			readNodeHalo(nodeGrids, currentBuffer, currentGrid, myRowCount, columns, haloDepth, haloAboveChanged, haloBelowChanged);
+			times.seconds[PHASE_HALO] += MPI_Wtime() - haloStart;
+
+			computeStart = MPI_Wtime();
+
+			// the first tile row and the last ones of my block need the ghost rows
+			activeTiles.clear();
+			findActiveTiles(changedTiles.data(), tileRowCount, tileColumnCount, tileColumnReach, bottomTileRow, 0, 1, haloAboveChanged, haloBelowChanged, activeTiles);
+			findActiveTiles(changedTiles.data(), tileRowCount, tileColumnCount, tileColumnReach, bottomTileRow, max(1, bottomTileRow), tileRowCount, haloAboveChanged, haloBelowChanged, activeTiles);
+			computeTiles(currentGrid, nextGrid, activeTiles, nextChangedTiles.data(), myRowCount, columns, tileColumnCount, haloDepth, rule);
+			if (cycleWindow > 0)
+			{
+				hashTiles(nextGrid, activeTiles, tileHashes.data(), firstRow, myRowCount, columns, tileColumnCount, haloDepth);
+			}
+			if (statsFile != NULL)
+			{
+				tallyTiles(currentGrid, nextGrid, activeTiles, tileStats.data(), myRowCount, columns, tileColumnCount, haloDepth);
+			}
+
+			computeTime += MPI_Wtime() - computeStart;
+			times.seconds[PHASE_COMPUTE] += MPI_Wtime() - computeStart;
+			times.generations++;
+
+			swap(currentGrid, nextGrid);
+			swap(changedTiles, nextChangedTiles);
+			currentBuffer = 1 - currentBuffer;
+			myRows = currentGrid + (long long)haloDepth * columns;
+
+			publishChanges(nodeGrids, tileRowsChanged(changedTiles.data(), 0, 1, tileColumnCount),
+				tileRowsChanged(changedTiles.data(), bottomTileRow, tileRowCount, tileColumnCount));
+		}
+
+		// this generation's numbers go to rank 0 while the next one is computed,
+		// the last generation's reduction has had a whole generation to finish
+		if (statsFile != NULL)
+		{
+			double outputStart = MPI_Wtime();
+
+			if (statsRequest != MPI_REQUEST_NULL)
+			{
+				MPI_Wait(&statsRequest, MPI_STATUS_IGNORE);
+				if (myRank == 0)
+				{
+					writeStatsLine(statsStream, boardStats);
+					keepStatsLine(statsHistory, boardStats, cycleWindow);
 				}
+			}
+
+			addUpTiles(tileStats.data(), tileCount, counter + 1, firstRow, myStats);
+			MPI_Ireduce(myStats, boardStats, 1, statsType, statsOp, 0, comm, &statsRequest);
+			times.seconds[PHASE_OUTPUT] += MPI_Wtime() - outputStart;
+		}
+
+		// once the board repeats itself every generation from here on is known,
+		// so skip over whole periods up to the next generation somebody wants to see
+		if (cycleWindow > 0)
+		{
+			unsigned long long myFingerprint = 0;
+			for (int tile = 0; tile < tileCount; tile++)
+			{
+				myFingerprint += tileHashes[tile];
+			}
 
+			unsigned long long fingerprint;
+			MPI_Allreduce(&myFingerprint, &fingerprint, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
 
+			int period = findCycle(fingerprintHistory, fingerprint, cycleWindow);
+			if (period > 0)
+			{
+				int limit = counter;
+				while (limit < iterations - 1 && !wantedGeneration(limit, startGeneration, printIteration, snapshotInterval, balanceInterval))
+				{
+					limit++;
+				}
+				int target = counter + ((limit - counter) / period) * period;
 
-				// bottom row of my block
-				else if (rowCounter == rowsPerProcessor - 1)
+				// the board after the jump is the one the history ended on, so
+				// the history stays good and the next jump can come right away
+				if (target > counter)
 				{
-					// not actually necessary lol
-					if (rowsPerProcessor == 1)
+					if (myRank == 0)
 					{
+						cerr << "generation " << counter + 1 << " is the same as generation " << counter + 1 - period
+							<< ", skipping ahead to generation " << target + 1 << endl;
 					}
-					//but neither is this I don't think
-					else if (rowsPerProcessor > 1)
+					// the skipped generations repeat the stats of a period earlier
+					if (statsFile != NULL)
 					{
-						if (elementCounter == rowsPerProcessor * columns)
-						{
-						}
-						else if (elementCounter == ((rowsPerProcessor * columns) + (columns - 1)))
+						double outputStart = MPI_Wtime();
+						MPI_Wait(&statsRequest, MPI_STATUS_IGNORE);
+						if (myRank == 0)
 						{
+							writeStatsLine(statsStream, boardStats);
+							keepStatsLine(statsHistory, boardStats, cycleWindow);
+							repeatStatsLines(statsStream, statsHistory, period, counter + 2, target + 1, cycleWindow);
 						}
+						times.seconds[PHASE_OUTPUT] += MPI_Wtime() - outputStart;
 					}
+
+					counter = target;
 				}
+			}
+		}
+
+		// my node neighbors read my rows in place, so the generation has to be
+		// done everywhere before anybody starts the next one
+		double barrierStart = MPI_Wtime();
+		syncNodeGrids(nodeGrids);
+		MPI_Barrier(comm);
+		syncNodeGrids(nodeGrids);
+		times.seconds[PHASE_BARRIER] += MPI_Wtime() - barrierStart;
+
+		// move rows between neighbors so everybody spends about the same time computing
+		if (balanceInterval > 0 && (counter + 1 - startGeneration) % balanceInterval == 0 && counter + 1 < iterations)
+		{
+			vector<int> newRowStarts(commSize + 1);
+			if (balanceRows(computeTime, rowStarts.data(), newRowStarts.data(), commSize, haloDepth, comm))
+			{
+				int newRowCount = newRowStarts[myRank + 1] - newRowStarts[myRank];
+
+				NodeGrids newGrids;
+				allocateNodeGrids(newGrids, comm, nodeComm, myRank, commSize, rankAbove, rankBelow, newRowCount, columns, haloDepth, temporalDepth == 1);
+				migrateRows(myRows, newGrids.grids[0] + (long long)haloDepth * columns, rowStarts.data(), newRowStarts.data(), myRank, columns, rowType, comm);
+				freeNodeGrids(nodeGrids);
+				nodeGrids = newGrids;
+
+				syncNodeGrids(nodeGrids);
+				MPI_Barrier(nodeComm);
+				syncNodeGrids(nodeGrids);
 
+				rowStarts = newRowStarts;
 
+				firstRow = rowStarts[myRank];
+				myRowCount = newRowCount;
+				currentBuffer = 0;
+				currentGrid = nodeGrids.grids[0];
+				nextGrid = nodeGrids.grids[1];
+				myRows = currentGrid + (long long)haloDepth * columns;
 
-				//rules governing life and death
-				if (myRows[elementCounter] == 1 && (aliveCounter < 2 || aliveCounter > 3))
+				// new tiles, and all of them have to go around once with full halos
+				tileRowCount = (myRowCount + TILE_ROWS - 1) / TILE_ROWS;
+				tileCount = tileRowCount * tileColumnCount;
+				bottomTileRow = max(0, (myRowCount - haloDepth) / TILE_ROWS);
+				changedTiles.assign(tileCount, 1);
+				nextChangedTiles.assign(tileCount, 0);
+				if (cycleWindow > 0)
 				{
-					myRows[elementCounter] = 0;
+					tileHashes.assign(tileCount, 0);
 				}
-				if (myRows[elementCounter] == 0 && aliveCounter == 3)
+				if (statsFile != NULL)
 				{
-					myRows[elementCounter] = 1;
+					tileStats.assign(tileCount, TileStats());
 				}
 			}
+			computeTime = 0;
 		}
 
-		MPI_Barrier(MPI_COMM_WORLD);
+		double outputStart = MPI_Wtime();
+
+		// everybody writes their own rows straight into the snapshot file
+		if (snapshotInterval > 0 && (counter + 1) % snapshotInterval == 0)
+		{
+			writeSnapshot(numberedFileName(snapshotPrefix, counter + 1, ".life").c_str(), comm, myRows, firstRow, myRowCount, rows, columns, counter + 1);
+		}
 
 		//print crap
-		if (counter % printIteration == 0)
+		if (counter % printIteration == 0 && framePrefix != NULL)
+		{
+			// the frame goes to disk in the background, the last one has had
+			// printIteration generations to get there
+			startFrame(frameWriter, numberedFileName(framePrefix, counter + 1, ".pbm").c_str(), comm, myRows, firstRow, myRowCount, rows, columns);
+		}
+		else if (counter % printIteration == 0 && !options.quiet)
 		{
 			if (myRank != 0)
         	{
         	    //send message
-        	    MPI_Send(myRows, blockLength, MPI_INT, 0, 0, MPI_COMM_WORLD);
+        	    MPI_Send(myRows, myRowCount, rowType, 0, 0, comm);
         	}
     		else if (myRank == 0)
     		{
     		    //Print my message
 				cout << endl;
 
-				for (int columnCounter = 0; columnCounter < blockLength; columnCounter++)
+				for (long long columnCounter = 0; columnCounter < (long long)myRowCount * columns; columnCounter++)
 				{
-					cout << myRows[columnCounter];
+					cout << (int)myRows[columnCounter];
 					if (columnCounter % columns == columns -1)
 					{
 						cout << endl;
 					}
 				}
 
-				int printedRows = rowsPerProcessor;
     		    for (int q = 1; q < commSize; q++)
 				{
+					int blockRows = rowStarts[q + 1] - rowStarts[q];
+					long long blockLength = (long long)blockRows * columns;
+					printRow.resize(blockLength);
+
     				//Receive message from process q
-    				MPI_Recv(printRow, blockLength, MPI_INT, q, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-					for (int columnCounter = 0; columnCounter < blockLength; columnCounter++)
+    				MPI_Recv(printRow.data(), blockRows, rowType, q, 0, comm, MPI_STATUS_IGNORE);
+					for (long long columnCounter = 0; columnCounter < blockLength; columnCounter++)
 					{
-						if (printedRows < rows)
+						cout << (int)printRow[columnCounter];
+						if (columnCounter % columns == columns - 1)
 						{
-							cout << printRow[columnCounter];
-							if (columnCounter % columns == columns - 1)
-							{
-								cout << endl;
-								printedRows++;
-							}
+							cout << endl;
 						}
 					}
 					//cout << endl;
 	    		}
 			}
    		}
+
+		times.seconds[PHASE_OUTPUT] += MPI_Wtime() - outputStart;
 	}
 
-	MPI_Finalize();
+	double outputStart = MPI_Wtime();
+	finishFrame(frameWriter);
 
-	delete[] aliveArray;
-	delete[] myRows;
-	delete[] rowAbove;
-	delete[] rowBelow;
+	if (statsFile != NULL)
+	{
+		if (statsRequest != MPI_REQUEST_NULL)
+		{
+			MPI_Wait(&statsRequest, MPI_STATUS_IGNORE);
+			if (myRank == 0)
+			{
+				writeStatsLine(statsStream, boardStats);
+			}
+		}
+		MPI_Op_free(&statsOp);
+		MPI_Type_free(&statsType);
+	}
 
+	times.seconds[PHASE_OUTPUT] += MPI_Wtime() - outputStart;
+	times.endTime = MPI_Wtime();
+	times.seconds[PHASE_TOTAL] = times.endTime - runStart;
 
-	return 0;
+	freeNodeGrids(nodeGrids);
+	MPI_Comm_free(&nodeComm);
+	MPI_Type_free(&rowType);
+
+	// whatever wasn't one of the phases: setting up, rebalancing, looking for cycles
+	times.seconds[PHASE_OTHER] = times.seconds[PHASE_TOTAL];
+	for (int phase = 0; phase < PHASE_OTHER; phase++)
+	{
+		times.seconds[PHASE_OTHER] -= times.seconds[phase];
+	}
+
+	return true;
 }
 
-void generateAlive(int* alive, int numberAlive, int rows, int columns)
+/*
+	The smallest, the average and the largest time of every phase over the
+	ranks of comm, on rank 0 of comm.
+*/
+void reducePhaseTimes(const PhaseTimes& times, MPI_Comm comm, PhaseTimes& minimum, PhaseTimes& average, PhaseTimes& maximum)
 {
-	srand(time(NULL));
-	for (int i = 0; i < numberAlive; i++)
+	int commSize;
+	MPI_Comm_size(comm, &commSize);
+
+	MPI_Reduce(times.seconds, minimum.seconds, PHASE_COUNT, MPI_DOUBLE, MPI_MIN, 0, comm);
+	MPI_Reduce(times.seconds, average.seconds, PHASE_COUNT, MPI_DOUBLE, MPI_SUM, 0, comm);
+	MPI_Reduce(times.seconds, maximum.seconds, PHASE_COUNT, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
 	{
-		alive[i] = rand() % (rows * columns);
+		average.seconds[phase] /= commSize;
 	}
 
-	return;
+	// every rank does the same generations
+	minimum.generations = times.generations;
+	average.generations = times.generations;
+	maximum.generations = times.generations;
 }
 
-void fillGrid(int* gridRow, int* alive, int numAlive, int myRank, int rowsPerProcess, int columns)
+/*
+	-timing: rank 0 puts a table on cerr with the smallest, average and
+	largest time of every phase over the ranks, and the average per
+	generation.  A max a lot bigger than the min in compute means the rows
+	are not balanced, and then the others wait in the barrier.  Then every
+	rank's start and end on rank 0's clock, from the first start, with how
+	far off its clock can be, so the ranks' runs can be lined up.
+*/
+void reportTiming(const PhaseTimes& times, const ClockSync& clock, MPI_Comm comm)
 {
-	int totalElementsPerProcess = rowsPerProcess * columns;
+	int myRank;
+	int commSize;
+	MPI_Comm_rank(comm, &myRank);
+	MPI_Comm_size(comm, &commSize);
 
-	for (int i = 0; i < numAlive; i++)
+	PhaseTimes minimum;
+	PhaseTimes average;
+	PhaseTimes maximum;
+	reducePhaseTimes(times, comm, minimum, average, maximum);
+
+	// start, end and the error bound of every rank
+	double myTimes[3] = { toGlobalTime(clock, times.startTime), toGlobalTime(clock, times.endTime), clock.delay / 2 };
+	vector<double> rankTimes(myRank == 0 ? 3 * commSize : 0);
+	MPI_Gather(myTimes, 3, MPI_DOUBLE, rankTimes.data(), 3, MPI_DOUBLE, 0, comm);
+
+	if (myRank != 0)
 	{
-		if (myRank == alive[i] / totalElementsPerProcess)
-		{
-			gridRow[alive[i] % totalElementsPerProcess] = 1;
-		}
+		return;
 	}
+
+	int generations = max(1, times.generations);
+
+	cerr << left << setw(12) << "phase" << right << setw(12) << "min (s)" << setw(12) << "avg (s)" << setw(12) << "max (s)" << setw(20) << "avg ms/generation" << endl;
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		cerr << left << setw(12) << PHASE_NAMES[phase] << right << fixed << setprecision(4)
+			<< setw(12) << minimum.seconds[phase] << setw(12) << average.seconds[phase] << setw(12) << maximum.seconds[phase]
+			<< setw(20) << 1000 * average.seconds[phase] / generations << endl;
+	}
+	cerr << times.generations << " generations computed" << endl;
+
+	double firstStart = rankTimes[0];
+	for (int rank = 1; rank < commSize; rank++)
+	{
+		firstStart = min(firstStart, rankTimes[3 * rank]);
+	}
+
+	cerr << left << setw(12) << "rank" << right << setw(12) << "start (ms)" << setw(12) << "end (ms)" << setw(20) << "clock error (us)" << endl;
+	for (int rank = 0; rank < commSize; rank++)
+	{
+		cerr << left << setw(12) << rank << right << fixed << setprecision(3)
+			<< setw(12) << 1000 * (rankTimes[3 * rank] - firstStart) << setw(12) << 1000 * (rankTimes[3 * rank + 1] - firstStart)
+			<< setw(20) << 1e6 * rankTimes[3 * rank + 2] << endl;
+	}
+}
+
+/*
+	-scaling: runs the board on the first 1, 2, 4, ... ranks and then on all
+	of them, each run on a communicator of its own while the other ranks wait.
+	Strong scaling keeps the board, weak scaling gives every rank the same
+	number of rows (and living cells) as the one rank run had.  Rank 0 writes
+	a CSV line per run with the wall time (the slowest rank), the speedup and
+	efficiency against one rank, and the min, avg and max of every phase.
+*/
+void runScaling(LifeOptions options, bool weak, const char* reportFile, MPI_Comm comm)
+{
+	int commSize;
+	int myRank;
+	MPI_Comm_size(comm, &commSize);
+	MPI_Comm_rank(comm, &myRank);
+
+	// every run gets the same board, and nothing gets printed or written
+	if (options.seed < 0)
+	{
+		options.seed = (myRank == 0) ? (long long)time(NULL) : 0;
+		MPI_Bcast(&options.seed, 1, MPI_LONG_LONG, 0, comm);
+	}
+	options.quiet = true;
+	options.printIteration = options.iterations;
+	options.snapshotInterval = 0;
+	options.framePrefix = NULL;
+	options.statsFile = NULL;
+
+	vector<int> processCounts;
+	for (int processes = 1; processes < commSize; processes *= 2)
+	{
+		processCounts.push_back(processes);
+	}
+	processCounts.push_back(commSize);
+
+	ofstream report;
+	if (myRank == 0)
+	{
+		report.open(reportFile);
+		report << "mode,processes,rows,columns,generations,seconds,speedup,efficiency";
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			report << "," << PHASE_NAMES[phase] << "_min," << PHASE_NAMES[phase] << "_avg," << PHASE_NAMES[phase] << "_max";
+		}
+		report << endl;
+	}
+
+	double oneRankSeconds = 0;
+
+	for (size_t run = 0; run < processCounts.size(); run++)
+	{
+		int processes = processCounts[run];
+
+		LifeOptions runOptions = options;
+		if (weak)
+		{
+			// the stacked board's rows still have to fit in an int
+			if ((long long)options.rows * processes > INT_MAX)
+			{
+				if (myRank == 0)
+				{
+					cerr << "weak scaling: stopping before " << processes << " processes, " << options.rows << " rows each is more than " << INT_MAX << " rows" << endl;
+				}
+				break;
+			}
+			runOptions.rows = options.rows * processes;
+			runOptions.livingCells = options.livingCells * processes;
+		}
+
+		MPI_Comm runComm;
+		MPI_Comm_split(comm, myRank < processes ? 0 : MPI_UNDEFINED, myRank, &runComm);
+
+		if (runComm != MPI_COMM_NULL)
+		{
+			PhaseTimes times;
+			bool ran = runSimulation(runOptions, runComm, times);
+
+			PhaseTimes minimum;
+			PhaseTimes average;
+			PhaseTimes maximum;
+			reducePhaseTimes(times, runComm, minimum, average, maximum);
+
+			if (myRank == 0 && ran)
+			{
+				double seconds = maximum.seconds[PHASE_TOTAL];
+				if (processes == 1)
+				{
+					oneRankSeconds = seconds;
+				}
+
+				// weak scaling does processes times the work, so its speedup is scaled up by that
+				double speedup = (weak ? processes : 1) * oneRankSeconds / seconds;
+
+				report << (weak ? "weak" : "strong") << "," << processes << "," << runOptions.rows << "," << runOptions.columns << ","
+					<< times.generations << "," << seconds << "," << speedup << "," << speedup / processes;
+				for (int phase = 0; phase < PHASE_COUNT; phase++)
+				{
+					report << "," << minimum.seconds[phase] << "," << average.seconds[phase] << "," << maximum.seconds[phase];
+				}
+				report << endl;
+
+				cerr << (weak ? "weak" : "strong") << " scaling: " << processes << " processes, " << seconds << " s" << endl;
+			}
+
+			MPI_Comm_free(&runComm);
+		}
+
+		MPI_Barrier(comm);
+	}
+}
+
+void printUsage()
+{
+	cout << "Usage: mpiexec -n <number of processes> ./life <number of living cells> <number of iterations> <number of iterations to print on> <number of rows> <number of columns> [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  -engine direct|hashlife   direct is the parallel engine (default), hashlife runs rank 0 only" << endl;
+	cout << "  -hashNodes <count>        most nodes the hashlife node pool may hold, steps that don't fit get split" << endl;
+	cout << "  -pattern <file>           start from an RLE (.rle) or plaintext pattern in the middle of the board" << endl;
+	cout << "  -restart <file>           start from a snapshot file" << endl;
+	cout << "  -snapshot <prefix> <k>    write <prefix>_<generation>.life every k generations (direct engine)" << endl;
+	cout << "  -balance <k>              move rows between neighbors every k generations to even out compute time" << endl;
+	cout << "  -frames <prefix>          write printed generations to <prefix>_<generation>.pbm in the background (direct engine)" << endl;
+	cout << "  -seed <n>                 seed for the random board, the same seed gives the same board on any number of processes" << endl;
+	cout << "  -kernel <name>            auto (default), scalar, sse2, avx2 or avx512 for radius 1 rules" << endl;
+	cout << "  -detectCycles <n>         look for the board repeating within n generations and skip ahead when it does (direct engine)" << endl;
+	cout << "  -stats <file>             write live cells, births, deaths and the bounding box of every generation to a CSV file (direct engine)" << endl;
+	cout << "  -temporal <d>             exchange a d generation deep halo and advance d generations between exchanges (no -stats or -detectCycles)" << endl;
+	cout << "  -timing                   print the min, avg and max over the ranks of the compute, halo wait, barrier and output time," << endl;
+	cout << "                            and every rank's start and end on a synced clock, to stderr" << endl;
+	cout << "  -scaling strong|weak <f>  run on 1, 2, 4, ... processes up to all of them, no printing, and write the times to the CSV file f" << endl;
+	cout << "  -rule <rule>              B3/S23 (default), 23/3, life, highlife, daynight, or Larger than Life like R5,C0,M1,S34..58,B34..45,NM" << endl;
+}
+
+/*
+	Fills rowCount rows of block, starting at board row firstRow, with the
+	starting board, which is a pattern file, a snapshot to restart from, or
+	random cells with numberAlive of them alive on average, see fillRandom.
+	A negative seed means rank 0 picks one.  Collective over comm.  Returns false, after
+	rank 0 says why, if the board could not be set up.
+*/
+bool setUpBoard(unsigned char* block, int firstRow, int rowCount, int rows, int columns, long long numberAlive, long long seed, const char* patternFile, const char* restartFile, MPI_Comm comm, int& startGeneration)
+{
+	int myRank;
+	MPI_Comm_rank(comm, &myRank);
+
+	startGeneration = 0;
+
+	if (restartFile != NULL)
+	{
+		if (!readSnapshot(restartFile, comm, block, firstRow, rowCount, rows, columns, startGeneration))
+		{
+			if (myRank == 0)
+			{
+				cout << restartFile << " is not a snapshot of a " << rows << " x " << columns << " board" << endl;
+			}
+			return false;
+		}
+		return true;
+	}
+
+	if (patternFile != NULL)
+	{
+		int patternRows;
+		int patternColumns;
+
+		if (!measurePattern(patternFile, patternRows, patternColumns) || patternRows > rows || patternColumns > columns)
+		{
+			if (myRank == 0)
+			{
+				cout << "Could not read " << patternFile << " or it does not fit on a " << rows << " x " << columns << " board" << endl;
+			}
+			return false;
+		}
+
+		// the pattern goes in the middle of the board
+		readPattern(patternFile, (rows - patternRows) / 2, (columns - patternColumns) / 2, firstRow, rowCount, columns, block);
+		return true;
+	}
+
+	// everybody has to use the same seed, so rank 0 picks one if nobody did
+	if (seed < 0)
+	{
+		seed = (myRank == 0) ? (long long)time(NULL) : 0;
+		MPI_Bcast(&seed, 1, MPI_LONG_LONG, 0, comm);
+	}
+
+	fillRandom(block, firstRow, rowCount, rows, columns, numberAlive, seed);
+
+	return true;
+}
+
+/*
+	Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+	3").  Ten rounds of multiplying and xoring mix the 128 bit counter with the
+	64 bit key, and the same counter and key always give the same four numbers,
+	so any rank can make up any cell's random number without asking anybody.
+*/
+void philox4x32(const unsigned int* counter, const unsigned int* key, unsigned int* result)
+{
+	const unsigned long long MULTIPLIER_0 = 0xD2511F53;
+	const unsigned long long MULTIPLIER_1 = 0xCD9E8D57;
+	const unsigned int WEYL_0 = 0x9E3779B9;
+	const unsigned int WEYL_1 = 0xBB67AE85;
+
+	unsigned int x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+	unsigned int k0 = key[0], k1 = key[1];
+
+	for (int round = 0; round < 10; round++)
+	{
+		unsigned long long product0 = MULTIPLIER_0 * x0;
+		unsigned long long product1 = MULTIPLIER_1 * x2;
+
+		unsigned int y0 = (unsigned int)(product1 >> 32) ^ x1 ^ k0;
+		unsigned int y1 = (unsigned int)product1;
+		unsigned int y2 = (unsigned int)(product0 >> 32) ^ x3 ^ k1;
+		unsigned int y3 = (unsigned int)product0;
+
+		x0 = y0; x1 = y1; x2 = y2; x3 = y3;
+		k0 += WEYL_0;
+		k1 += WEYL_1;
+	}
+
+	result[0] = x0;
+	result[1] = x1;
+	result[2] = x2;
+	result[3] = x3;
+}
+
+/*
+	Fills rowCount rows of block, starting at board row firstRow, with random
+	cells so that numberAlive of them are alive on average.  A cell's random
+	number only depends on the seed and on where the cell is on the board, one
+	Philox call covers four cells in a row, so the board is the same for any
+	number of ranks and threads.
+*/
+void fillRandom(unsigned char* block, int firstRow, int rowCount, int rows, int columns, long long numberAlive, long long seed)
+{
+	long long cellCount = (long long)rows * columns;
+
+	// alive when the 32 bit random number is below numberAlive / cellCount of 2^32
+	unsigned long long threshold = ((unsigned long long)min(numberAlive, cellCount) << 32) / cellCount;
+
+	unsigned int key[2] = { (unsigned int)seed, (unsigned int)((unsigned long long)seed >> 32) };
+
+	#pragma omp parallel for schedule(static)
+	for (int rowCounter = 0; rowCounter < rowCount; rowCounter++)
+	{
+		long long firstCell = (long long)(firstRow + rowCounter) * columns;
+		unsigned char* cells = block + (long long)rowCounter * columns;
+
+		unsigned int random[4];
+		long long philoxBlock = -1;
+
+		for (int elementCounter = 0; elementCounter < columns; elementCounter++)
+		{
+			long long cell = firstCell + elementCounter;
+
+			if (cell / 4 != philoxBlock)
+			{
+				philoxBlock = cell / 4;
+				unsigned int counter[4] = { (unsigned int)philoxBlock, (unsigned int)((unsigned long long)philoxBlock >> 32), 0, 0 };
+				philox4x32(counter, key, random);
+			}
+
+			cells[elementCounter] = random[cell % 4] < threshold;
+		}
+	}
+}
+
+/*
+	Posts the halo exchange for one generation.  My top haloDepth rows go up and
+	land in the bottom ghost rows of the rank above, my bottom haloDepth rows go
+	down and land in the top ghost rows of the rank below.  The two directions
+	use different tags so it still works when the rank above and the rank below
+	are the same process.  Rows that did not change since the last generation
+	are sent as an empty message so the neighbor can keep its old ghost rows.
+	The count is in rows (rowType), so it stays small for any width.  Only
+	called from the main thread.
+*/
+void exchangeHalo(unsigned char* grid, int rowCount, int columns, int haloDepth, MPI_Datatype rowType, int rankAbove, int rankBelow, bool sendTop, bool sendBottom, MPI_Comm comm, MPI_Request* requests)
+{
+	long long haloLength = (long long)haloDepth * columns;
+
+	unsigned char* topGhostRows = grid;
+	unsigned char* firstRows = grid + haloLength;
+	unsigned char* lastRows = grid + (long long)rowCount * columns;
+	unsigned char* bottomGhostRows = grid + haloLength + (long long)rowCount * columns;
+
+	MPI_Irecv(topGhostRows, haloDepth, rowType, rankAbove, SENT_DOWN, comm, &requests[0]);
+	MPI_Irecv(bottomGhostRows, haloDepth, rowType, rankBelow, SENT_UP, comm, &requests[1]);
+	MPI_Isend(firstRows, sendTop ? haloDepth : 0, rowType, rankAbove, SENT_UP, comm, &requests[2]);
+	MPI_Isend(lastRows, sendBottom ? haloDepth : 0, rowType, rankBelow, SENT_DOWN, comm, &requests[3]);
+}
+
+/*
+	Looks at the completed halo receives.  An empty message means the neighbor's
+	rows are the same as last generation, and last generation's copy of them sits
+	in the ghost rows of the other grid, so it gets copied over.  Sides with a
+	neighbor on my node (MPI_PROC_NULL) are left alone, see readNodeHalo.
+*/
+void finishHalo(unsigned char* grid, const unsigned char* otherGrid, int rowCount, int columns, int haloDepth, MPI_Datatype rowType, MPI_Status* statuses, bool& aboveChanged, bool& belowChanged)
+{
+	int receivedAbove;
+	int receivedBelow;
+	MPI_Get_count(&statuses[0], rowType, &receivedAbove);
+	MPI_Get_count(&statuses[1], rowType, &receivedBelow);
+
+	aboveChanged = receivedAbove > 0;
+	belowChanged = receivedBelow > 0;
+
+	long long haloLength = (long long)haloDepth * columns;
+	long long bottomGhostOffset = haloLength + (long long)rowCount * columns;
+
+	if (!aboveChanged && statuses[0].MPI_SOURCE != MPI_PROC_NULL)
+	{
+		copy(otherGrid, otherGrid + haloLength, grid);
+	}
+	if (!belowChanged && statuses[1].MPI_SOURCE != MPI_PROC_NULL)
+	{
+		copy(otherGrid + bottomGhostOffset, otherGrid + bottomGhostOffset + haloLength, grid + bottomGhostOffset);
+	}
+}
+
+/*
+	True if any tile in tile rows [firstTileRow, lastTileRow) changed last generation.
+*/
+bool tileRowsChanged(const char* changedTiles, int firstTileRow, int lastTileRow, int tileColumnCount)
+{
+	for (int tile = firstTileRow * tileColumnCount; tile < lastTileRow * tileColumnCount; tile++)
+	{
+		if (changedTiles[tile])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+	Adds the tiles in tile rows [firstTileRow, lastTileRow) that have to be
+	recomputed to activeTiles.  A tile only can change if it or one of its
+	neighbor tiles changed last generation.  Tile columns wrap around, and a
+	narrow last tile column means the reach wraps one tile further.  Tile row 0
+	also wakes up when the ghost rows above changed, and the tile rows from
+	bottomTileRow on when the ghost rows below changed.
+*/
+void findActiveTiles(const char* changedTiles, int tileRowCount, int tileColumnCount, int tileColumnReach, int bottomTileRow, int firstTileRow, int lastTileRow, bool haloAboveChanged, bool haloBelowChanged, vector<int>& activeTiles)
+{
+	for (int tileRow = firstTileRow; tileRow < lastTileRow; tileRow++)
+	{
+		bool haloChanged = (tileRow == 0 && haloAboveChanged) || (tileRow >= bottomTileRow && haloBelowChanged);
+
+		for (int tileColumn = 0; tileColumn < tileColumnCount; tileColumn++)
+		{
+			bool active = haloChanged;
+
+			for (int rowOffset = -1; rowOffset <= 1 && !active; rowOffset++)
+			{
+				int neighborRow = tileRow + rowOffset;
+				if (neighborRow < 0 || neighborRow >= tileRowCount)
+				{
+					continue;
+				}
+
+				for (int columnOffset = -tileColumnReach; columnOffset <= tileColumnReach && !active; columnOffset++)
+				{
+					int neighborColumn = ((tileColumn + columnOffset) % tileColumnCount + tileColumnCount) % tileColumnCount;
+					active = changedTiles[neighborRow * tileColumnCount + neighborColumn] != 0;
+				}
+			}
+
+			if (active)
+			{
+				activeTiles.push_back(tileRow * tileColumnCount + tileColumn);
+			}
+		}
+	}
+}
+
+/*
+	Computes the next generation of the listed tiles into nextGrid and marks
+	the ones where some cell changed.  The tiles are handed out to the OpenMP
+	threads dynamically since some tiles are a lot cheaper than others at the
+	edge of the board.
+*/
+void computeTiles(const unsigned char* grid, unsigned char* nextGrid, const vector<int>& tiles, char* changedTiles, int rowCount, int columns, int tileColumnCount, int haloDepth, const LifeRule& rule)
+{
+	int tileListLength = tiles.size();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int tileCounter = 0; tileCounter < tileListLength; tileCounter++)
+	{
+		int tile = tiles[tileCounter];
+		int firstRow = (tile / tileColumnCount) * TILE_ROWS;
+		int firstColumn = (tile % tileColumnCount) * TILE_COLUMNS;
+
+		changedTiles[tile] = computeCells(grid, nextGrid, firstRow, min(firstRow + TILE_ROWS, rowCount),
+			firstColumn, min(firstColumn + TILE_COLUMNS, columns), columns, haloDepth, rule);
+	}
+}
+
+/*
+	Hash of a live cell at a place on the board, the splitmix64 finalizer.
+*/
+unsigned long long cellHash(unsigned long long cellIndex)
+{
+	unsigned long long hash = cellIndex + 0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return hash ^ (hash >> 31);
+}
+
+/*
+	Redoes the hashes of the listed tiles of grid, the sum of cellHash over
+	their live cells.  Sums don't care about order, so the tiles and the ranks
+	can be added up in any order too.  Tiles that were not recomputed did not
+	change and keep their hash.
+*/
+void hashTiles(const unsigned char* grid, const vector<int>& tiles, unsigned long long* tileHashes, int firstBoardRow, int rowCount, int columns, int tileColumnCount, int haloDepth)
+{
+	int tileListLength = tiles.size();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int tileCounter = 0; tileCounter < tileListLength; tileCounter++)
+	{
+		int tile = tiles[tileCounter];
+		int firstRow = (tile / tileColumnCount) * TILE_ROWS;
+		int lastRow = min(firstRow + TILE_ROWS, rowCount);
+		int firstColumn = (tile % tileColumnCount) * TILE_COLUMNS;
+		int lastColumn = min(firstColumn + TILE_COLUMNS, columns);
+
+		unsigned long long hash = 0;
+		for (int rowCounter = firstRow; rowCounter < lastRow; rowCounter++)
+		{
+			const unsigned char* cells = grid + (long long)(rowCounter + haloDepth) * columns;
+			unsigned long long rowIndex = (unsigned long long)(firstBoardRow + rowCounter) * columns;
+
+			for (int elementCounter = firstColumn; elementCounter < lastColumn; elementCounter++)
+			{
+				if (cells[elementCounter])
+				{
+					hash += cellHash(rowIndex + elementCounter);
+				}
+			}
+		}
+
+		tileHashes[tile] = hash;
+	}
+}
+
+/*
+	Redoes the numbers of the listed tiles after they were computed from grid
+	into nextGrid: births and deaths by comparing the two, and the live cells
+	and their bounding box in nextGrid, in rows of my block.
+*/
+void tallyTiles(const unsigned char* grid, const unsigned char* nextGrid, const vector<int>& tiles, TileStats* tileStats, int rowCount, int columns, int tileColumnCount, int haloDepth)
+{
+	int tileListLength = tiles.size();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int tileCounter = 0; tileCounter < tileListLength; tileCounter++)
+	{
+		int tile = tiles[tileCounter];
+		int firstRow = (tile / tileColumnCount) * TILE_ROWS;
+		int lastRow = min(firstRow + TILE_ROWS, rowCount);
+		int firstColumn = (tile % tileColumnCount) * TILE_COLUMNS;
+		int lastColumn = min(firstColumn + TILE_COLUMNS, columns);
+
+		TileStats stats;
+		for (int rowCounter = firstRow; rowCounter < lastRow; rowCounter++)
+		{
+			const unsigned char* before = grid + (long long)(rowCounter + haloDepth) * columns;
+			const unsigned char* after = nextGrid + (long long)(rowCounter + haloDepth) * columns;
+
+			for (int elementCounter = firstColumn; elementCounter < lastColumn; elementCounter++)
+			{
+				stats.births += after[elementCounter] & ~before[elementCounter] & 1;
+				stats.deaths += before[elementCounter] & ~after[elementCounter] & 1;
+
+				if (after[elementCounter])
+				{
+					stats.live++;
+					stats.minRow = min(stats.minRow, rowCounter);
+					stats.maxRow = max(stats.maxRow, rowCounter);
+					stats.minColumn = min(stats.minColumn, elementCounter);
+					stats.maxColumn = max(stats.maxColumn, elementCounter);
+				}
+			}
+		}
+
+		tileStats[tile] = stats;
+	}
+}
+
+/*
+	Adds up the tiles into the STATS_FIELDS numbers of a generation, with the
+	bounding box in board rows.
+*/
+void addUpTiles(const TileStats* tileStats, int tileCount, int generation, int firstBoardRow, long long* stats)
+{
+	stats[0] = generation;
+	stats[1] = 0;
+	stats[2] = 0;
+	stats[3] = 0;
+	stats[4] = LLONG_MAX;
+	stats[5] = -1;
+	stats[6] = LLONG_MAX;
+	stats[7] = -1;
+
+	for (int tile = 0; tile < tileCount; tile++)
+	{
+		stats[1] += tileStats[tile].live;
+		stats[2] += tileStats[tile].births;
+		stats[3] += tileStats[tile].deaths;
+
+		if (tileStats[tile].live > 0)
+		{
+			stats[4] = min(stats[4], (long long)firstBoardRow + tileStats[tile].minRow);
+			stats[5] = max(stats[5], (long long)firstBoardRow + tileStats[tile].maxRow);
+			stats[6] = min(stats[6], (long long)tileStats[tile].minColumn);
+			stats[7] = max(stats[7], (long long)tileStats[tile].maxColumn);
+		}
+	}
+}
+
+/*
+	MPI_Op for the generation numbers, length is in generations of
+	STATS_FIELDS numbers each.  The counts add up and the bounding boxes take
+	the smallest and the largest edges.
+*/
+void combineStats(void* input, void* inputOutput, int* length, MPI_Datatype*)
+{
+	const long long* in = (const long long*)input;
+	long long* inOut = (long long*)inputOutput;
+
+	for (int start = 0; start < *length * STATS_FIELDS; start += STATS_FIELDS)
+	{
+		inOut[start + 1] += in[start + 1];
+		inOut[start + 2] += in[start + 2];
+		inOut[start + 3] += in[start + 3];
+		inOut[start + 4] = min(inOut[start + 4], in[start + 4]);
+		inOut[start + 5] = max(inOut[start + 5], in[start + 5]);
+		inOut[start + 6] = min(inOut[start + 6], in[start + 6]);
+		inOut[start + 7] = max(inOut[start + 7], in[start + 7]);
+	}
+}
+
+/*
+	One CSV line, with an empty bounding box when nobody is alive.
+*/
+void writeStatsLine(ofstream& statsStream, const long long* stats)
+{
+	statsStream << stats[0] << "," << stats[1] << "," << stats[2] << "," << stats[3];
+	if (stats[1] > 0)
+	{
+		statsStream << "," << stats[4] << "," << stats[5] << "," << stats[6] << "," << stats[7] << "\n";
+	}
+	else
+	{
+		statsStream << ",,,,\n";
+	}
+}
+
+/*
+	Keeps the stats of the last window generations for repeatStatsLines,
+	nothing without -detectCycles.
+*/
+void keepStatsLine(deque<vector<long long> >& history, const long long* stats, int window)
+{
+	if (window <= 0)
+	{
+		return;
+	}
+
+	history.push_back(vector<long long>(stats, stats + STATS_FIELDS));
+	if ((int)history.size() > window)
+	{
+		history.pop_front();
+	}
+}
+
+/*
+	Writes the lines of generations firstGeneration to lastGeneration, which
+	got skipped because the board repeats every period generations, so each
+	one is the line of period generations before it.  history has to end
+	with the line of firstGeneration - 1.
+*/
+void repeatStatsLines(ofstream& statsStream, deque<vector<long long> >& history, int period, int firstGeneration, int lastGeneration, int window)
+{
+	for (int generation = firstGeneration; generation <= lastGeneration; generation++)
+	{
+		vector<long long> stats = history[history.size() - period];
+		stats[0] = generation;
+		writeStatsLine(statsStream, stats.data());
+		keepStatsLine(history, stats.data(), window);
+	}
+}
+
+/*
+	Adds the newest fingerprint to the history and returns the period if it
+	is the same as one of the last window fingerprints, 0 if it isn't.
+*/
+int findCycle(deque<unsigned long long>& history, unsigned long long fingerprint, int window)
+{
+	int period = 0;
+	for (int back = 1; back <= (int)history.size() && period == 0; back++)
+	{
+		if (history[history.size() - back] == fingerprint)
+		{
+			period = back;
+		}
+	}
+
+	history.push_back(fingerprint);
+	if ((int)history.size() > window)
+	{
+		history.pop_front();
+	}
+
+	return period;
+}
+
+/*
+	Computes the next generation of block rows [firstRow, lastRow) and columns
+	[firstColumn, lastColumn) into nextGrid, and says whether any of those cells
+	changed.  Radius 1 rules go through the vector kernel (life_simd.cpp) for
+	the columns that don't wrap around, and the scalar kernel does the rest.
+	Bigger neighborhoods go to the Larger than Life kernel.
+*/
+bool computeCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule)
+{
+	if (rule.radius > 1)
+	{
+		return computeLargerCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, rule);
+	}
+
+	int vectorFirst = max(firstColumn, 1);
+	int vectorLast = min(lastColumn, columns - 1);
+
+	if (vectorFirst >= vectorLast)
+	{
+		return computeScalarCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, rule);
+	}
+
+	bool changed = false;
+	int vectorDone = vectorMooreCells(grid, nextGrid, firstRow, lastRow, vectorFirst, vectorLast, columns, haloDepth, mooreTable(rule.birthMask, rule.survivalMask), changed);
+
+	if (firstColumn < vectorFirst)
+	{
+		changed |= computeScalarCells(grid, nextGrid, firstRow, lastRow, firstColumn, vectorFirst, columns, haloDepth, rule);
+	}
+	if (vectorDone < lastColumn)
+	{
+		changed |= computeScalarCells(grid, nextGrid, firstRow, lastRow, vectorDone, lastColumn, columns, haloDepth, rule);
+	}
+
+	return changed;
+}
+
+/*
+	Scalar radius 1 cells.  Life, HighLife and Day & Night get their own
+	compiled kernel, other rules share one that reads the rule table at run time.
+*/
+bool computeScalarCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule)
+{
+	switch (mooreTable(rule.birthMask, rule.survivalMask))
+	{
+	case ConwayRule::TABLE:
+		return computeMooreCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, ConwayRule());
+	case HighLifeRule::TABLE:
+		return computeMooreCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, HighLifeRule());
+	case DayAndNightRule::TABLE:
+		return computeMooreCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, DayAndNightRule());
+	default:
+		return computeMooreCells(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, RuntimeMooreRule(rule));
+	}
+}
+
+/*
+	Radius 1 kernel.  Row r of the block lives at grid row r + haloDepth
+	because of the ghost rows on top, and the columns wrap around like the rows
+	do.  The rule is a template parameter, so for the compiled-in rules the
+	transition is a shift of a constant and the loop has no branches in it.
+*/
+template <class Rule>
+bool computeMooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const Rule& rule)
+{
+	int changed = 0;
+
+	for (int rowCounter = firstRow; rowCounter < lastRow; rowCounter++)
+	{
+		const unsigned char* current = grid + (long long)(rowCounter + haloDepth) * columns;
+		const unsigned char* above = current - columns;
+		const unsigned char* below = current + columns;
+		unsigned char* next = nextGrid + (long long)(rowCounter + haloDepth) * columns;
+
+		for (int elementCounter = firstColumn; elementCounter < lastColumn; elementCounter++)
+		{
+			int left = (elementCounter == 0) ? columns - 1 : elementCounter - 1;
+			int right = (elementCounter == columns - 1) ? 0 : elementCounter + 1;
+
+			int aliveCounter = above[left] + above[elementCounter] + above[right]
+				+ current[left] + current[right]
+				+ below[left] + below[elementCounter] + below[right];
+
+			//rules governing life and death
+			next[elementCounter] = rule.next(current[elementCounter], aliveCounter);
+
+			changed |= next[elementCounter] ^ current[elementCounter];
+		}
+	}
+
+	return changed != 0;
+}
+
+/*
+	Kernel for any radius, used for Larger than Life.  Every row from haloDepth
+	above the tile to haloDepth below it gets its horizontal window sums done
+	once, and a running sum down each column adds up 2r + 1 of them for every
+	cell, so a cell costs a few additions no matter how big the radius is.
+*/
+bool computeLargerCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule)
+{
+	int radius = rule.radius;
+	int width = lastColumn - firstColumn;
+	int sumRows = (lastRow - firstRow) + 2 * radius;
+	int stateStride = rule.maxCount + 1;
+
+	vector<int> rowSums((size_t)sumRows * width);
+
+	for (int sumRow = 0; sumRow < sumRows; sumRow++)
+	{
+		const unsigned char* cells = grid + (long long)(firstRow - radius + sumRow + haloDepth) * columns;
+		int* sums = rowSums.data() + (size_t)sumRow * width;
+
+		int windowSum = 0;
+		for (int offset = -radius; offset <= radius; offset++)
+		{
+			windowSum += cells[((firstColumn + offset) % columns + columns) % columns];
+		}
+		sums[0] = windowSum;
+
+		for (int column = 1; column < width; column++)
+		{
+			int entering = (firstColumn + column + radius) % columns;
+			int leaving = ((firstColumn + column - radius - 1) % columns + columns) % columns;
+			windowSum += cells[entering] - cells[leaving];
+			sums[column] = windowSum;
+		}
+	}
+
+	vector<int> columnSums(width, 0);
+	for (int sumRow = 0; sumRow < 2 * radius; sumRow++)
+	{
+		for (int column = 0; column < width; column++)
+		{
+			columnSums[column] += rowSums[sumRow * width + column];
+		}
+	}
+
+	int changed = 0;
+
+	for (int rowCounter = firstRow; rowCounter < lastRow; rowCounter++)
+	{
+		int newest = (rowCounter - firstRow + 2 * radius) * width;
+		int oldest = (rowCounter - firstRow) * width;
+
+		const unsigned char* current = grid + (long long)(rowCounter + haloDepth) * columns;
+		unsigned char* next = nextGrid + (long long)(rowCounter + haloDepth) * columns;
+
+		for (int column = 0; column < width; column++)
+		{
+			columnSums[column] += rowSums[newest + column];
+
+			int state = current[firstColumn + column];
+			int aliveCounter = columnSums[column] - state;
+
+			next[firstColumn + column] = rule.table[state * stateStride + aliveCounter];
+			changed |= next[firstColumn + column] ^ state;
+
+			columnSums[column] -= rowSums[oldest + column];
+		}
+	}
+
+	return changed != 0;
+}
+
+/*
+	True if the board has to be all there after generation counter + 1,
+	because it gets printed, snapshotted or rebalanced.
+*/
+bool wantedGeneration(int counter, int startGeneration, int printIteration, int snapshotInterval, int balanceInterval)
+{
+	return counter % printIteration == 0
+		|| (snapshotInterval > 0 && (counter + 1) % snapshotInterval == 0)
+		|| (balanceInterval > 0 && (counter + 1 - startGeneration) % balanceInterval == 0);
+}
+
+/*
+	How many rows go in a band for -temporal, so that a band and the skewed
+	rows around it, in both grids, about fit in the L2 cache.
+*/
+int temporalBandRows(int columns, int haloDepth, int radius)
+{
+	long long cacheBytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (cacheBytes <= 0)
+	{
+		cacheBytes = 1 << 20;
+	}
+
+	long long bandRows = cacheBytes / (2LL * columns) - 2 * haloDepth;
+	return (int)max((long long)radius, bandRows);
+}
+
+/*
+	Advances my block steps generations, steps * radius being at most
+	haloDepth, with the halo already filled in.  Generation s is good on the
+	rows from haloDepth - s * radius above my block to as far below it, so
+	every generation does a few less ghost rows until my own rows are left.
+
+	The rows (ghost rows included) are cut into bands of bandRows and every
+	band goes through all the generations before the next band starts.  At
+	generation s a band is moved up s * radius rows, so it only needs rows
+	of generation s - 1 that this band or the one before it already did.
+	That skew is also why two grids are enough: what a band writes at
+	generation s is above anything the next band still has to read from
+	generation s - 2.  The columns of a band are split among the threads.
+*/
+void advanceGenerations(unsigned char* grid, unsigned char* otherGrid, int steps, int rowCount, int columns, int haloDepth, int bandRows, const LifeRule& rule)
+{
+	int radius = rule.radius;
+	int top = -haloDepth;
+	int bottom = rowCount + haloDepth;
+	int columnChunks = (columns + TILE_COLUMNS - 1) / TILE_COLUMNS;
+
+	for (int bandStart = top; bandStart < bottom; bandStart += bandRows)
+	{
+		int bandEnd = min(bandStart + bandRows, bottom);
+
+		for (int step = 1; step <= steps; step++)
+		{
+			const unsigned char* from = (step % 2 == 1) ? grid : otherGrid;
+			unsigned char* to = (step % 2 == 1) ? otherGrid : grid;
+
+			int firstRow = max(bandStart - step * radius, top + step * radius);
+			int lastRow = min(bandEnd - step * radius, bottom - step * radius);
+			if (firstRow >= lastRow)
+			{
+				continue;
+			}
+
+			#pragma omp parallel for schedule(static)
+			for (int chunk = 0; chunk < columnChunks; chunk++)
+			{
+				int firstColumn = chunk * TILE_COLUMNS;
+				computeCells(from, to, firstRow, lastRow, firstColumn, min(firstColumn + TILE_COLUMNS, columns), columns, haloDepth, rule);
+			}
+		}
+	}
+}
+
+/*
+	Decides where the block boundaries should go from the time every rank spent
+	computing.  Each rank's time is spread evenly over its rows, and the new
+	boundaries cut the board into pieces of the same total time.  A boundary
+	only moves inside the two blocks next to it, so rows only go to a neighbor,
+	and every rank keeps at least minRows rows.  Collective over comm.  Returns false
+	when the blocks are already close enough to even.
+*/
+bool balanceRows(double computeTime, const int* rowStarts, int* newRowStarts, int commSize, int minRows, MPI_Comm comm)
+{
+	vector<double> times(commSize);
+	MPI_Allgather(&computeTime, 1, MPI_DOUBLE, times.data(), 1, MPI_DOUBLE, comm);
+
+	double totalTime = 0;
+	double slowest = 0;
+	for (int rank = 0; rank < commSize; rank++)
+	{
+		totalTime += times[rank];
+		slowest = max(slowest, times[rank]);
+	}
+
+	// not worth moving anything for less than 5 percent
+	if (totalTime <= 0 || slowest < 1.05 * totalTime / commSize)
+	{
+		return false;
+	}
+
+	newRowStarts[0] = rowStarts[0];
+	newRowStarts[commSize] = rowStarts[commSize];
+
+	int rank = 0;
+	double timeBefore = 0;
+
+	for (int boundary = 1; boundary < commSize; boundary++)
+	{
+		double target = totalTime * boundary / commSize;
+
+		while (rank < commSize - 1 && timeBefore + times[rank] < target)
+		{
+			timeBefore += times[rank];
+			rank++;
+		}
+
+		int blockRows = rowStarts[rank + 1] - rowStarts[rank];
+		double timePerRow = times[rank] / blockRows;
+		int wanted = rowStarts[rank];
+		if (timePerRow > 0)
+		{
+			wanted += (int)((target - timeBefore) / timePerRow + 0.5);
+		}
+
+		int lowest = max(rowStarts[boundary - 1], newRowStarts[boundary - 1]) + minRows;
+		int highest = rowStarts[boundary + 1] - minRows;
+		newRowStarts[boundary] = max(lowest, min(highest, wanted));
+	}
+
+	return true;
+}
+
+/*
+	Fills my new block from my old one and the rows that changed owner between
+	me and my neighbors.  Both boundaries of a block only ever move into a
+	neighbor's old block, see balanceRows.  Rows go out as rowType so the
+	counts are rows, not cells.  Collective over comm.
+*/
+void migrateRows(const unsigned char* myOldRows, unsigned char* myNewRows, const int* rowStarts, const int* newRowStarts, int myRank, int columns, MPI_Datatype rowType, MPI_Comm comm)
+{
+	const int MIGRATE_TAG = 3;
+
+	int commSize;
+	MPI_Comm_size(comm, &commSize);
+
+	int oldFirst = rowStarts[myRank];
+	int oldLast = rowStarts[myRank + 1];
+	int newFirst = newRowStarts[myRank];
+	int newLast = newRowStarts[myRank + 1];
+
+	// the rows I keep
+	int keptFirst = max(oldFirst, newFirst);
+	int keptLast = min(oldLast, newLast);
+	copy(myOldRows + (long long)(keptFirst - oldFirst) * columns, myOldRows + (long long)(keptLast - oldFirst) * columns, myNewRows + (long long)(keptFirst - newFirst) * columns);
+
+	MPI_Request requests[4];
+	int requestCount = 0;
+
+	// top boundary: rows come down from the rank above or go up to it
+	if (myRank > 0 && newFirst < oldFirst)
+	{
+		MPI_Irecv(myNewRows, oldFirst - newFirst, rowType, myRank - 1, MIGRATE_TAG, comm, &requests[requestCount++]);
+	}
+	else if (myRank > 0 && newFirst > oldFirst)
+	{
+		MPI_Isend(myOldRows, newFirst - oldFirst, rowType, myRank - 1, MIGRATE_TAG, comm, &requests[requestCount++]);
+	}
+
+	// bottom boundary: rows go down to the rank below or come up from it
+	if (myRank < commSize - 1 && newLast < oldLast)
+	{
+		MPI_Isend(myOldRows + (long long)(newLast - oldFirst) * columns, oldLast - newLast, rowType, myRank + 1, MIGRATE_TAG, comm, &requests[requestCount++]);
+	}
+	else if (myRank < commSize - 1 && newLast > oldLast)
+	{
+		MPI_Irecv(myNewRows + (long long)(oldLast - newFirst) * columns, newLast - oldLast, rowType, myRank + 1, MIGRATE_TAG, comm, &requests[requestCount++]);
+	}
+
+	MPI_Waitall(requestCount, requests, MPI_STATUSES_IGNORE);
 }
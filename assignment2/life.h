@@ -1,15 +1,166 @@
 #ifndef BK_CGL_H
 #define BK_CGL_H
 
+#include <mpi.h>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <climits>
+#include "life_rules.h"
+#include "clock_sync.h"
+
 
 // m: rows
 // n: columns
 // j: iterations
-// i: number of cells alive
+// i: number of cells alive (on average, for a random board)
 // k: print every kth iteration (skip k-1 iterations)
 
-void generateAlive(int* alive, int numberAlive, int rows, int columns);
+// first row of rank id when n rows are split over p ranks
+#define BLOCK_LOW(id,p,n)	((int)((long long)(id)*(n)/(p)))
+
+void printUsage();
+
+// what the direct engine gets from the command line
+struct LifeOptions
+{
+	// each side fits in an int, rows * columns is always taken as long long
+	int rows;
+	int columns;
+	int iterations;
+	int printIteration;
+	long long livingCells;
+	long long seed;
+	const char* patternFile;
+	const char* restartFile;
+	const char* snapshotPrefix;
+	int snapshotInterval;
+	int balanceInterval;
+	const char* framePrefix;
+	int cycleWindow;
+	const char* statsFile;
+	int temporalDepth;
+	bool quiet;
+	LifeRule rule;
+};
+
+// where the time of a run goes, the phases -timing and -scaling report
+const int PHASE_COMPUTE = 0;
+const int PHASE_HALO = 1;
+const int PHASE_BARRIER = 2;
+const int PHASE_OUTPUT = 3;
+const int PHASE_OTHER = 4;
+const int PHASE_TOTAL = 5;
+const int PHASE_COUNT = 6;
+
+const char* const PHASE_NAMES[PHASE_COUNT] = { "compute", "halo_wait", "barrier", "output", "other", "total" };
+
+// request and reply exchanges per rank when -timing syncs the clocks
+const int CLOCK_SAMPLES = 20;
+
+// seconds of one rank in every phase, how many generations it computed, and
+// its MPI_Wtime when the run started and ended
+struct PhaseTimes
+{
+	double seconds[PHASE_COUNT];
+	int generations;
+	double startTime;
+	double endTime;
+
+	PhaseTimes() : generations(0), startTime(0), endTime(0)
+	{
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			seconds[phase] = 0;
+		}
+	}
+};
+
+bool runSimulation(const LifeOptions& options, MPI_Comm comm, PhaseTimes& times);
+
+void reducePhaseTimes(const PhaseTimes& times, MPI_Comm comm, PhaseTimes& minimum, PhaseTimes& average, PhaseTimes& maximum);
+
+void reportTiming(const PhaseTimes& times, const ClockSync& clock, MPI_Comm comm);
+
+void runScaling(LifeOptions options, bool weak, const char* reportFile, MPI_Comm comm);
+
+bool setUpBoard(unsigned char* block, int firstRow, int rowCount, int rows, int columns, long long numberAlive, long long seed, const char* patternFile, const char* restartFile, MPI_Comm comm, int& startGeneration);
+
+void philox4x32(const unsigned int* counter, const unsigned int* key, unsigned int* result);
+
+void fillRandom(unsigned char* block, int firstRow, int rowCount, int rows, int columns, long long numberAlive, long long seed);
+
+// halo message tags, from the point of view of the sender
+const int SENT_UP = 1;
+const int SENT_DOWN = 2;
+
+// the block is split into tiles of TILE_ROWS x TILE_COLUMNS cells, and
+// only tiles next to a change get recomputed
+const int TILE_ROWS = 16;
+const int TILE_COLUMNS = 256;
+
+// grid: my block with haloDepth ghost rows above and below it
+void exchangeHalo(unsigned char* grid, int rowCount, int columns, int haloDepth, MPI_Datatype rowType, int rankAbove, int rankBelow, bool sendTop, bool sendBottom, MPI_Comm comm, MPI_Request* requests);
+
+void finishHalo(unsigned char* grid, const unsigned char* otherGrid, int rowCount, int columns, int haloDepth, MPI_Datatype rowType, MPI_Status* statuses, bool& aboveChanged, bool& belowChanged);
+
+bool tileRowsChanged(const char* changedTiles, int firstTileRow, int lastTileRow, int tileColumnCount);
+
+void findActiveTiles(const char* changedTiles, int tileRowCount, int tileColumnCount, int tileColumnReach, int bottomTileRow, int firstTileRow, int lastTileRow, bool haloAboveChanged, bool haloBelowChanged, std::vector<int>& activeTiles);
+
+void computeTiles(const unsigned char* grid, unsigned char* nextGrid, const std::vector<int>& tiles, char* changedTiles, int rowCount, int columns, int tileColumnCount, int haloDepth, const LifeRule& rule);
+
+unsigned long long cellHash(unsigned long long cellIndex);
+
+void hashTiles(const unsigned char* grid, const std::vector<int>& tiles, unsigned long long* tileHashes, int firstBoardRow, int rowCount, int columns, int tileColumnCount, int haloDepth);
+
+// what -stats keeps for every tile, in rows and columns of my block
+struct TileStats
+{
+	long long live;
+	long long births;
+	long long deaths;
+	int minRow, maxRow, minColumn, maxColumn;
+
+	TileStats() : live(0), births(0), deaths(0), minRow(INT_MAX), maxRow(-1), minColumn(INT_MAX), maxColumn(-1) {}
+};
+
+// generation, live, births, deaths, then the bounding box: min row, max row, min column, max column
+const int STATS_FIELDS = 8;
+
+void tallyTiles(const unsigned char* grid, const unsigned char* nextGrid, const std::vector<int>& tiles, TileStats* tileStats, int rowCount, int columns, int tileColumnCount, int haloDepth);
+
+void addUpTiles(const TileStats* tileStats, int tileCount, int generation, int firstBoardRow, long long* stats);
+
+void combineStats(void* input, void* inputOutput, int* length, MPI_Datatype* datatype);
+
+void writeStatsLine(std::ofstream& statsStream, const long long* stats);
+
+// the last window lines, and the lines of skipped generations made from them
+void keepStatsLine(std::deque<std::vector<long long> >& history, const long long* stats, int window);
+void repeatStatsLines(std::ofstream& statsStream, std::deque<std::vector<long long> >& history, int period, int firstGeneration, int lastGeneration, int window);
+
+// the period if fingerprint is one of the last window in history, or 0
+int findCycle(std::deque<unsigned long long>& history, unsigned long long fingerprint, int window);
+
+bool computeCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule);
+
+bool computeScalarCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule);
+
+template <class Rule>
+bool computeMooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const Rule& rule);
+
+bool computeLargerCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, const LifeRule& rule);
+
+bool wantedGeneration(int counter, int startGeneration, int printIteration, int snapshotInterval, int balanceInterval);
+
+int temporalBandRows(int columns, int haloDepth, int radius);
+
+void advanceGenerations(unsigned char* grid, unsigned char* otherGrid, int steps, int rowCount, int columns, int haloDepth, int bandRows, const LifeRule& rule);
+
+// rowStarts[r] is the first board row of rank r, rowStarts[commSize] is the number of rows
+bool balanceRows(double computeTime, const int* rowStarts, int* newRowStarts, int commSize, int minRows, MPI_Comm comm);
 
-void fillGrid(int* gridRow, int* alive, int numAlive, int myRank, int rowsPerProcess, int columns);
+void migrateRows(const unsigned char* myOldRows, unsigned char* myNewRows, const int* rowStarts, const int* newRowStarts, int myRank, int columns, MPI_Datatype rowType, MPI_Comm comm);
 
 #endif
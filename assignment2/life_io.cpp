@@ -0,0 +1,431 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "life_io.h"
+
+/*
+Board input and output for the Game of Life that does not go through rank 0.
+
+Patterns come in as RLE files (the format Golly and the LifeWiki use) or
+plaintext files (lines of '.' and 'O').  Every rank parses the pattern by
+itself and only keeps the cells that land in its own rows, so there is no
+broadcast of the whole board.
+
+Snapshots are a packed binary dump of the board, one bit per cell, written
+and read collectively with MPI-IO.  Every row takes the same number of bytes,
+so each rank knows exactly where its rows go in the file.
+
+Frames are binary PBM images, which are bit-packed rows too.  A frame is
+packed into a buffer and every rank hands its rows to a thread of its own
+that opens the file and writes them with pwrite, and the simulation goes on
+meanwhile.  Nothing in a frame is collective, there is no MPI_File_open or
+MPI_File_set_size for everybody to wait on every frame, and the thread
+never calls MPI, so MPI_THREAD_FUNNELED is enough.  The rank with the last
+row cuts the file to its size in case an older, bigger one was there.  A
+frame only has to be finished when the next one comes around, so printing
+does not hold up rank 0 or anybody waiting on it.
+*/
+
+using namespace std;
+
+static bool isRleFile(const char* fileName)
+{
+	int length = strlen(fileName);
+	return length >= 4 && strcmp(fileName + length - 4, ".rle") == 0;
+}
+
+/*
+	Reads "x = 3, y = 2, rule = B3/S23" out of an RLE header line.
+*/
+static bool readRleHeader(const string& line, int& patternRows, int& patternColumns)
+{
+	patternRows = -1;
+	patternColumns = -1;
+
+	for (size_t position = 0; position < line.size(); position++)
+	{
+		char name = line[position];
+		if (name != 'x' && name != 'y')
+		{
+			continue;
+		}
+
+		size_t equals = line.find('=', position);
+		if (equals == string::npos)
+		{
+			break;
+		}
+
+		int value = atoi(line.c_str() + equals + 1);
+		if (name == 'x' && patternColumns < 0)
+		{
+			patternColumns = value;
+		}
+		else if (name == 'y' && patternRows < 0)
+		{
+			patternRows = value;
+		}
+		position = equals;
+	}
+
+	return patternRows >= 0 && patternColumns >= 0;
+}
+
+bool measurePattern(const char* fileName, int& patternRows, int& patternColumns)
+{
+	ifstream file(fileName);
+	if (!file)
+	{
+		return false;
+	}
+
+	string line;
+
+	if (isRleFile(fileName))
+	{
+		while (getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			return readRleHeader(line, patternRows, patternColumns);
+		}
+		return false;
+	}
+
+	patternRows = 0;
+	patternColumns = 0;
+	while (getline(file, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+		if (!line.empty() && (line[0] == '!' || line[0] == '#'))
+		{
+			continue;
+		}
+		patternRows++;
+		patternColumns = max(patternColumns, (int)line.size());
+	}
+
+	return true;
+}
+
+/*
+	Marks cells [column, column + length) of a pattern row as alive if the row
+	is one of mine.
+*/
+static void placeRun(int boardRow, int boardColumn, int length, int firstRow, int rowCount, int columns, unsigned char* block)
+{
+	if (boardRow < firstRow || boardRow >= firstRow + rowCount)
+	{
+		return;
+	}
+
+	unsigned char* row = block + (long long)(boardRow - firstRow) * columns;
+	for (int column = max(boardColumn, 0); column < boardColumn + length && column < columns; column++)
+	{
+		row[column] = 1;
+	}
+}
+
+bool readPattern(const char* fileName, int offsetRow, int offsetColumn, int firstRow, int rowCount, int columns, unsigned char* block)
+{
+	ifstream file(fileName);
+	if (!file)
+	{
+		return false;
+	}
+
+	string line;
+
+	if (!isRleFile(fileName))
+	{
+		int patternRow = 0;
+		while (getline(file, line))
+		{
+			if (!line.empty() && (line[0] == '!' || line[0] == '#'))
+			{
+				continue;
+			}
+
+			int boardRow = offsetRow + patternRow;
+			if (boardRow >= firstRow && boardRow < firstRow + rowCount)
+			{
+				for (size_t patternColumn = 0; patternColumn < line.size(); patternColumn++)
+				{
+					if (line[patternColumn] == 'O' || line[patternColumn] == '*')
+					{
+						placeRun(boardRow, offsetColumn + patternColumn, 1, firstRow, rowCount, columns, block);
+					}
+				}
+			}
+			patternRow++;
+		}
+		return true;
+	}
+
+	// skip the comments and the header
+	bool sawHeader = false;
+	while (!sawHeader && getline(file, line))
+	{
+		sawHeader = !(line.empty() || line[0] == '#');
+	}
+	if (!sawHeader)
+	{
+		return false;
+	}
+
+	int patternRow = 0;
+	int patternColumn = 0;
+	int runLength = 0;
+	char symbol;
+
+	while (file.get(symbol))
+	{
+		if (isdigit(symbol))
+		{
+			runLength = runLength * 10 + (symbol - '0');
+			continue;
+		}
+
+		int count = runLength > 0 ? runLength : 1;
+		runLength = 0;
+
+		if (symbol == '!')
+		{
+			break;
+		}
+		else if (symbol == '$')
+		{
+			patternRow += count;
+			patternColumn = 0;
+		}
+		else if (symbol == 'b' || symbol == '.')
+		{
+			patternColumn += count;
+		}
+		else if (isalpha(symbol))
+		{
+			// o, and the other states of multi-state rules, are all alive here
+			placeRun(offsetRow + patternRow, offsetColumn + patternColumn, count, firstRow, rowCount, columns, block);
+			patternColumn += count;
+		}
+
+		// once we are past my rows there is nothing left for me in the file
+		if (offsetRow + patternRow >= firstRow + rowCount)
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+int packedRowBytes(int columns)
+{
+	return (columns + 7) / 8;
+}
+
+/*
+	A packed row as one MPI element, so file reads and writes count rows and
+	a block of more than 2^31 bytes still has an int count.
+*/
+static MPI_Datatype packedRowType(int rowBytes)
+{
+	MPI_Datatype packedRow;
+	MPI_Type_contiguous(rowBytes, MPI_BYTE, &packedRow);
+	MPI_Type_commit(&packedRow);
+	return packedRow;
+}
+
+void packRows(const unsigned char* block, int rowCount, int columns, unsigned char* packed)
+{
+	int rowBytes = packedRowBytes(columns);
+
+	for (int row = 0; row < rowCount; row++)
+	{
+		const unsigned char* cells = block + (long long)row * columns;
+		unsigned char* bytes = packed + (long long)row * rowBytes;
+
+		memset(bytes, 0, rowBytes);
+		for (int column = 0; column < columns; column++)
+		{
+			if (cells[column])
+			{
+				bytes[column / 8] |= 0x80 >> (column % 8);
+			}
+		}
+	}
+}
+
+void unpackRows(const unsigned char* packed, int rowCount, int columns, unsigned char* block)
+{
+	int rowBytes = packedRowBytes(columns);
+
+	for (int row = 0; row < rowCount; row++)
+	{
+		unsigned char* cells = block + (long long)row * columns;
+		const unsigned char* bytes = packed + (long long)row * rowBytes;
+
+		for (int column = 0; column < columns; column++)
+		{
+			cells[column] = (bytes[column / 8] >> (7 - column % 8)) & 1;
+		}
+	}
+}
+
+string numberedFileName(const char* prefix, int generation, const char* extension)
+{
+	char number[32];
+	sprintf(number, "_%08d", generation);
+	return string(prefix) + number + extension;
+}
+
+void writeSnapshot(const char* fileName, MPI_Comm comm, const unsigned char* block, int firstRow, int rowCount, int rows, int columns, int generation)
+{
+	int myRank;
+	MPI_Comm_rank(comm, &myRank);
+
+	MPI_File file;
+	MPI_File_open(comm, (char*)fileName, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+	MPI_File_set_size(file, 0);
+
+	if (myRank == 0)
+	{
+		long long header[4];
+		memcpy(&header[0], SNAPSHOT_MAGIC, 8);
+		header[1] = rows;
+		header[2] = columns;
+		header[3] = generation;
+		MPI_File_write_at(file, 0, header, SNAPSHOT_HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+	}
+
+	int rowBytes = packedRowBytes(columns);
+	vector<unsigned char> packed((size_t)rowCount * rowBytes);
+	packRows(block, rowCount, columns, packed.data());
+
+	MPI_Datatype packedRow = packedRowType(rowBytes);
+	MPI_Offset offset = SNAPSHOT_HEADER_BYTES + (MPI_Offset)firstRow * rowBytes;
+	MPI_File_write_at_all(file, offset, packed.data(), rowCount, packedRow, MPI_STATUS_IGNORE);
+	MPI_Type_free(&packedRow);
+
+	MPI_File_close(&file);
+}
+
+bool readSnapshot(const char* fileName, MPI_Comm comm, unsigned char* block, int firstRow, int rowCount, int rows, int columns, int& generation)
+{
+	MPI_File file;
+	if (MPI_File_open(comm, (char*)fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+	{
+		return false;
+	}
+
+	long long header[4];
+	MPI_File_read_at_all(file, 0, header, SNAPSHOT_HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+
+	if (memcmp(&header[0], SNAPSHOT_MAGIC, 8) != 0 || header[1] != rows || header[2] != columns)
+	{
+		MPI_File_close(&file);
+		return false;
+	}
+	generation = header[3];
+
+	int rowBytes = packedRowBytes(columns);
+	vector<unsigned char> packed((size_t)rowCount * rowBytes);
+
+	MPI_Datatype packedRow = packedRowType(rowBytes);
+	MPI_Offset offset = SNAPSHOT_HEADER_BYTES + (MPI_Offset)firstRow * rowBytes;
+	MPI_File_read_at_all(file, offset, packed.data(), rowCount, packedRow, MPI_STATUS_IGNORE);
+	MPI_Type_free(&packedRow);
+	MPI_File_close(&file);
+
+	unpackRows(packed.data(), rowCount, columns, block);
+
+	return true;
+}
+
+// all of bytes at offset, pwrite can stop short
+static bool writeAllAt(int file, const unsigned char* bytes, long long count, long long offset)
+{
+	while (count > 0)
+	{
+		ssize_t written = pwrite(file, bytes, count, offset);
+		if (written <= 0)
+		{
+			return false;
+		}
+		bytes += written;
+		count -= written;
+		offset += written;
+	}
+	return true;
+}
+
+// the frame thread: my part of the file, then the size if I have the last row
+static void writeFrameFile(FrameWriter* writer)
+{
+	int file = open(writer->fileName.c_str(), O_WRONLY | O_CREAT, 0644);
+	if (file < 0)
+	{
+		writer->failed = true;
+		return;
+	}
+
+	bool written = writeAllAt(file, (const unsigned char*)writer->header.data(), writer->header.size(), 0)
+		&& writeAllAt(file, writer->packed.data(), writer->packed.size(), writer->offset);
+	if (written && writer->fileBytes > 0)
+	{
+		written = ftruncate(file, writer->fileBytes) == 0;
+	}
+
+	writer->failed = close(file) != 0 || !written;
+}
+
+void startFrame(FrameWriter& writer, const char* fileName, MPI_Comm comm, const unsigned char* block, int firstRow, int rowCount, int rows, int columns)
+{
+	int myRank;
+	MPI_Comm_rank(comm, &myRank);
+
+	finishFrame(writer);
+
+	char header[64];
+	sprintf(header, "P4\n%d %d\n", columns, rows);
+
+	int rowBytes = packedRowBytes(columns);
+	writer.packed.resize((size_t)rowCount * rowBytes);
+	packRows(block, rowCount, columns, writer.packed.data());
+
+	writer.fileName = fileName;
+	writer.header = (myRank == 0) ? header : "";
+	writer.offset = strlen(header) + (long long)firstRow * rowBytes;
+	writer.fileBytes = (firstRow + rowCount == rows) ? strlen(header) + (long long)rows * rowBytes : 0;
+
+	writer.thread = thread(writeFrameFile, &writer);
+	writer.pending = true;
+}
+
+void finishFrame(FrameWriter& writer)
+{
+	if (!writer.pending)
+	{
+		return;
+	}
+
+	writer.thread.join();
+	if (writer.failed)
+	{
+		cerr << "Could not write the frame " << writer.fileName << endl;
+	}
+
+	writer.pending = false;
+}
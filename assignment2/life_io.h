@@ -0,0 +1,61 @@
+#ifndef BK_LIFE_IO_H
+#define BK_LIFE_IO_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <thread>
+
+// snapshot files: a SNAPSHOT_HEADER_BYTES header (magic, rows, columns and
+// generation as 64 bit ints), then every row bit-packed into
+// (columns + 7) / 8 bytes, most significant bit first
+const char SNAPSHOT_MAGIC[9] = "LIFESNAP";
+const int SNAPSHOT_HEADER_BYTES = 32;
+
+// size of an RLE (.rle) or plaintext (.cells) pattern
+bool measurePattern(const char* fileName, int& patternRows, int& patternColumns);
+
+// puts the live cells of a pattern whose top left corner goes at
+// (offsetRow, offsetColumn) into the rowCount rows of block that start at
+// board row firstRow.  Every rank reads the file by itself and keeps its rows.
+bool readPattern(const char* fileName, int offsetRow, int offsetColumn, int firstRow, int rowCount, int columns, unsigned char* block);
+
+int packedRowBytes(int columns);
+void packRows(const unsigned char* block, int rowCount, int columns, unsigned char* packed);
+void unpackRows(const unsigned char* packed, int rowCount, int columns, unsigned char* block);
+
+// <prefix>_<generation><extension>, with the generation padded to 8 digits
+std::string numberedFileName(const char* prefix, int generation, const char* extension);
+
+// collective over comm, each rank writes rowCount rows starting at board row firstRow
+void writeSnapshot(const char* fileName, MPI_Comm comm, const unsigned char* block, int firstRow, int rowCount, int rows, int columns, int generation);
+
+// collective over comm, returns false if the file is not a snapshot of a rows x columns board
+bool readSnapshot(const char* fileName, MPI_Comm comm, unsigned char* block, int firstRow, int rowCount, int rows, int columns, int& generation);
+
+// a frame that is on its way to disk while the simulation keeps going, my
+// rows of it written by a thread of its own
+struct FrameWriter
+{
+	bool pending;
+	bool failed;
+	std::thread thread;
+	std::string fileName;
+	// only rank 0 writes the header
+	std::string header;
+	std::vector<unsigned char> packed;
+	// where my rows go, and the size of the whole file if I have the last row
+	long long offset;
+	long long fileBytes;
+
+	FrameWriter() : pending(false), failed(false) {}
+};
+
+// not collective.  Packs my rows into the writer's buffer and starts a thread
+// that writes them into a binary PBM (P4) file.
+void startFrame(FrameWriter& writer, const char* fileName, MPI_Comm comm, const unsigned char* block, int firstRow, int rowCount, int rows, int columns);
+
+// not collective.  Waits for the frame in flight, if any.
+void finishFrame(FrameWriter& writer);
+
+#endif
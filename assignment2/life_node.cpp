@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstring>
+#include "life_node.h"
+
+/*
+Shared memory halos for the ranks on one node.  Every node rank puts its part
+of each grid into an MPI_Win_allocate_shared window, and since the memory of
+such a window is one piece with the ranks in order, the blocks of ranks that
+are next to each other on the board end up next to each other in memory.
+Those ranks leave out the ghost rows between them and read each other's rows
+right where they are.  Where the board wraps around on the node the rows get
+copied out of the window, and only neighbors on other nodes get messages.
+
+Nothing here waits for anybody.  A rank only reads its neighbors' rows of
+the grid everybody is reading from, and the barrier at the end of every
+generation (with MPI_Win_sync on both sides of it) makes sure the writes of
+the last generation are done and visible.  The flags that say whether a
+neighbor's rows changed have two slots, so a rank that is a generation ahead
+writes the slot nobody is reading.
+*/
+
+using namespace std;
+
+/*
+	Allocates the two grid windows and the flag window, with or without
+	leaving out the ghost rows between neighbors.  Returns false if the
+	windows did not come out as one piece, which MPI promises but which is
+	checked anyway since the grids depend on it.
+*/
+static bool tryAllocate(NodeGrids& grids, MPI_Comm comm, MPI_Comm nodeComm, int myRank, int commSize, int rankAbove, int rankBelow, int rowCount, int columns, int haloDepth, bool shareRows)
+{
+	int localRank;
+	MPI_Comm_rank(nodeComm, &localRank);
+
+	// where my neighbors are in nodeComm, MPI_UNDEFINED if on another node
+	MPI_Group group;
+	MPI_Group nodeGroup;
+	MPI_Comm_group(comm, &group);
+	MPI_Comm_group(nodeComm, &nodeGroup);
+
+	int neighbors[2] = { rankAbove, rankBelow };
+	int localNeighbors[2];
+	MPI_Group_translate_ranks(group, 2, neighbors, nodeGroup, localNeighbors);
+	MPI_Group_free(&group);
+	MPI_Group_free(&nodeGroup);
+
+	int localAbove = localNeighbors[0];
+	int localBelow = localNeighbors[1];
+
+	grids.nodeComm = nodeComm;
+	grids.flagSlot = 0;
+
+	// the rank above comes right before me in the window if it is the node
+	// rank before me and the board doesn't wrap around between us
+	grids.adjacentAbove = shareRows && localAbove != MPI_UNDEFINED && myRank > 0 && localAbove == localRank - 1;
+	grids.adjacentBelow = shareRows && localBelow != MPI_UNDEFINED && myRank < commSize - 1 && localBelow == localRank + 1;
+
+	long long haloBytes = (long long)haloDepth * columns;
+	long long topGhostBytes = grids.adjacentAbove ? 0 : haloBytes;
+	long long segmentBytes = topGhostBytes + (long long)rowCount * columns + (grids.adjacentBelow ? 0 : haloBytes);
+
+	bool inOnePiece = true;
+
+	for (int buffer = 0; buffer < 2; buffer++)
+	{
+		unsigned char* segment;
+		MPI_Win_allocate_shared(segmentBytes, 1, MPI_INFO_NULL, nodeComm, &segment, &grids.gridWindows[buffer]);
+		MPI_Win_lock_all(MPI_MODE_NOCHECK, grids.gridWindows[buffer]);
+
+		memset(segment, 0, segmentBytes);
+		grids.grids[buffer] = segment + topGhostBytes - haloBytes;
+
+		if (grids.adjacentAbove)
+		{
+			MPI_Aint size;
+			int displacementUnit;
+			unsigned char* neighborSegment;
+			MPI_Win_shared_query(grids.gridWindows[buffer], localAbove, &size, &displacementUnit, &neighborSegment);
+			inOnePiece = inOnePiece && neighborSegment + size == segment;
+		}
+
+		// a node neighbor that isn't next to me has ghost rows of its own on
+		// my side, so its rows I need are just inside those
+		grids.rowsAbove[buffer] = NULL;
+		grids.rowsBelow[buffer] = NULL;
+
+		if (localAbove != MPI_UNDEFINED && !grids.adjacentAbove)
+		{
+			MPI_Aint size;
+			int displacementUnit;
+			unsigned char* neighborSegment;
+			MPI_Win_shared_query(grids.gridWindows[buffer], localAbove, &size, &displacementUnit, &neighborSegment);
+			grids.rowsAbove[buffer] = neighborSegment + size - 2 * haloBytes;
+		}
+		if (localBelow != MPI_UNDEFINED && !grids.adjacentBelow)
+		{
+			MPI_Aint size;
+			int displacementUnit;
+			unsigned char* neighborSegment;
+			MPI_Win_shared_query(grids.gridWindows[buffer], localBelow, &size, &displacementUnit, &neighborSegment);
+			grids.rowsBelow[buffer] = neighborSegment + haloBytes;
+		}
+	}
+
+	MPI_Win_allocate_shared(4 * sizeof(int), sizeof(int), MPI_INFO_NULL, nodeComm, &grids.myFlags, &grids.flagWindow);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, grids.flagWindow);
+
+	// everything counts as changed until the first generation is done
+	fill(grids.myFlags, grids.myFlags + 4, 1);
+
+	grids.flagsAbove = NULL;
+	grids.flagsBelow = NULL;
+
+	MPI_Aint size;
+	int displacementUnit;
+	if (localAbove != MPI_UNDEFINED)
+	{
+		int* neighborFlags;
+		MPI_Win_shared_query(grids.flagWindow, localAbove, &size, &displacementUnit, &neighborFlags);
+		grids.flagsAbove = neighborFlags;
+	}
+	if (localBelow != MPI_UNDEFINED)
+	{
+		int* neighborFlags;
+		MPI_Win_shared_query(grids.flagWindow, localBelow, &size, &displacementUnit, &neighborFlags);
+		grids.flagsBelow = neighborFlags;
+	}
+
+	int allInOnePiece;
+	int mine = inOnePiece ? 1 : 0;
+	MPI_Allreduce(&mine, &allInOnePiece, 1, MPI_INT, MPI_LAND, nodeComm);
+
+	return allInOnePiece != 0;
+}
+
+void allocateNodeGrids(NodeGrids& grids, MPI_Comm comm, MPI_Comm nodeComm, int myRank, int commSize, int rankAbove, int rankBelow, int rowCount, int columns, int haloDepth, bool shareRows)
+{
+	if (!tryAllocate(grids, comm, nodeComm, myRank, commSize, rankAbove, rankBelow, rowCount, columns, haloDepth, shareRows))
+	{
+		// every rank keeps all of its ghost rows then, the rows still don't go through messages
+		freeNodeGrids(grids);
+		tryAllocate(grids, comm, nodeComm, myRank, commSize, rankAbove, rankBelow, rowCount, columns, haloDepth, false);
+	}
+
+	// nobody reads a neighbor's rows before the neighbor has zeroed them
+	syncNodeGrids(grids);
+	MPI_Barrier(nodeComm);
+	syncNodeGrids(grids);
+}
+
+void freeNodeGrids(NodeGrids& grids)
+{
+	for (int buffer = 0; buffer < 2; buffer++)
+	{
+		MPI_Win_unlock_all(grids.gridWindows[buffer]);
+		MPI_Win_free(&grids.gridWindows[buffer]);
+	}
+
+	MPI_Win_unlock_all(grids.flagWindow);
+	MPI_Win_free(&grids.flagWindow);
+}
+
+void syncNodeGrids(NodeGrids& grids)
+{
+	MPI_Win_sync(grids.gridWindows[0]);
+	MPI_Win_sync(grids.gridWindows[1]);
+	MPI_Win_sync(grids.flagWindow);
+}
+
+void publishChanges(NodeGrids& grids, bool topChanged, bool bottomChanged)
+{
+	grids.flagSlot = 1 - grids.flagSlot;
+	grids.myFlags[grids.flagSlot * 2] = topChanged ? 1 : 0;
+	grids.myFlags[grids.flagSlot * 2 + 1] = bottomChanged ? 1 : 0;
+}
+
+void readNodeHalo(const NodeGrids& grids, int buffer, unsigned char* grid, int rowCount, int columns, int haloDepth, bool& aboveChanged, bool& belowChanged)
+{
+	long long haloBytes = (long long)haloDepth * columns;
+
+	// the neighbor above's bottom rows and the neighbor below's top rows
+	if (grids.flagsAbove != NULL)
+	{
+		aboveChanged = grids.flagsAbove[grids.flagSlot * 2 + 1] != 0;
+	}
+	if (grids.flagsBelow != NULL)
+	{
+		belowChanged = grids.flagsBelow[grids.flagSlot * 2] != 0;
+	}
+
+	if (grids.rowsAbove[buffer] != NULL)
+	{
+		memcpy(grid, grids.rowsAbove[buffer], haloBytes);
+	}
+	if (grids.rowsBelow[buffer] != NULL)
+	{
+		memcpy(grid + haloBytes + (long long)rowCount * columns, grids.rowsBelow[buffer], haloBytes);
+	}
+}
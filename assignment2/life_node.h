@@ -0,0 +1,64 @@
+#ifndef BK_LIFE_NODE_H
+#define BK_LIFE_NODE_H
+
+#include <mpi.h>
+
+/*
+	The two grids of a rank live in MPI shared memory windows, one window per
+	grid, shared by all the ranks on the node.  A window is one piece of
+	memory with the ranks' blocks one after the other, so when the rank above
+	me is also the node rank before me my top ghost rows are just its last
+	rows, and nothing has to be sent at all.  Neighbors on other nodes still
+	get messages.
+*/
+struct NodeGrids
+{
+	MPI_Comm nodeComm;
+	MPI_Win gridWindows[2];
+	MPI_Win flagWindow;
+
+	// grids[b] starts haloDepth rows above my first row in buffer b
+	unsigned char* grids[2];
+
+	// whether my top and bottom rows changed last generation, two slots
+	// (flags[slot * 2] top, flags[slot * 2 + 1] bottom) so a slow neighbor
+	// can still read one while I write the other
+	int* myFlags;
+	int flagSlot;
+
+	// the neighbors' flags if they are on this node, NULL if they aren't
+	const int* flagsAbove;
+	const int* flagsBelow;
+
+	// my ghost rows are the neighbor's own rows
+	bool adjacentAbove;
+	bool adjacentBelow;
+
+	// a neighbor on this node that is not next to me in the window (where the
+	// board wraps around): its rows in buffer b, copied into my ghost rows
+	const unsigned char* rowsAbove[2];
+	const unsigned char* rowsBelow[2];
+};
+
+// collective over nodeComm, a split of comm that myRank, rankAbove and
+// rankBelow are ranks of.  Makes zeroed grids for rowCount rows, with ghost
+// rows of my own only on the sides where the neighbor isn't right next to me.
+// shareRows false keeps all my ghost rows, for when I write into them.
+void allocateNodeGrids(NodeGrids& grids, MPI_Comm comm, MPI_Comm nodeComm, int myRank, int commSize, int rankAbove, int rankBelow, int rowCount, int columns, int haloDepth, bool shareRows);
+
+// collective over nodeComm
+void freeNodeGrids(NodeGrids& grids);
+
+// makes my writes to the windows visible to the node, call it before and
+// after the barrier that ends a generation
+void syncNodeGrids(NodeGrids& grids);
+
+// records whether my top and bottom rows changed in the generation that just
+// finished, for my neighbors to read after the barrier
+void publishChanges(NodeGrids& grids, bool topChanged, bool bottomChanged);
+
+// fills in aboveChanged and belowChanged for the neighbors on this node and
+// copies the rows of the ones that aren't right next to me into my ghost rows
+void readNodeHalo(const NodeGrids& grids, int buffer, unsigned char* grid, int rowCount, int columns, int haloDepth, bool& aboveChanged, bool& belowChanged);
+
+#endif
@@ -0,0 +1,240 @@
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include "life_rules.h"
+
+/*
+Parsing of rule strings for Life-like automata.  Every rule ends up as a
+lookup table from (state, neighbor count) to the next state, and radius 1
+rules also get their birth and survival bit masks so the kernel can pick a
+compiled-in version of the common ones.
+*/
+
+using namespace std;
+
+/*
+	Fills in the table from "born with these counts" and "survive with these
+	counts" lists, where the counts do not include the cell itself.
+*/
+static void buildTable(LifeRule& rule, const vector<char>& birth, const vector<char>& survival)
+{
+	rule.table.assign(2 * (rule.maxCount + 1), 0);
+	rule.birthMask = 0;
+	rule.survivalMask = 0;
+
+	for (int count = 0; count <= rule.maxCount; count++)
+	{
+		rule.table[count] = birth[count];
+		rule.table[(rule.maxCount + 1) + count] = survival[count];
+
+		if (rule.radius == 1 && birth[count])
+		{
+			rule.birthMask |= 1u << count;
+		}
+		if (rule.radius == 1 && survival[count])
+		{
+			rule.survivalMask |= 1u << count;
+		}
+	}
+}
+
+/*
+	B3/S23 style, or 23/3 with the survival counts first.
+*/
+static bool parseBirthSurvival(const string& text, LifeRule& rule)
+{
+	size_t slash = text.find('/');
+	if (slash == string::npos)
+	{
+		return false;
+	}
+
+	string first = text.substr(0, slash);
+	string second = text.substr(slash + 1);
+	string birthDigits;
+	string survivalDigits;
+
+	if (!first.empty() && toupper(first[0]) == 'B' && !second.empty() && toupper(second[0]) == 'S')
+	{
+		birthDigits = first.substr(1);
+		survivalDigits = second.substr(1);
+	}
+	else if (!first.empty() && toupper(first[0]) == 'S' && !second.empty() && toupper(second[0]) == 'B')
+	{
+		survivalDigits = first.substr(1);
+		birthDigits = second.substr(1);
+	}
+	else
+	{
+		survivalDigits = first;
+		birthDigits = second;
+	}
+
+	rule.radius = 1;
+	rule.maxCount = 8;
+
+	vector<char> birth(9, 0);
+	vector<char> survival(9, 0);
+
+	for (size_t digit = 0; digit < birthDigits.size(); digit++)
+	{
+		if (birthDigits[digit] < '0' || birthDigits[digit] > '8')
+		{
+			return false;
+		}
+		birth[birthDigits[digit] - '0'] = 1;
+	}
+	for (size_t digit = 0; digit < survivalDigits.size(); digit++)
+	{
+		if (survivalDigits[digit] < '0' || survivalDigits[digit] > '8')
+		{
+			return false;
+		}
+		survival[survivalDigits[digit] - '0'] = 1;
+	}
+
+	buildTable(rule, birth, survival);
+
+	return true;
+}
+
+/*
+	Reads "a..b" (or just "a") into low and high.
+*/
+static bool parseRange(const string& text, int& low, int& high)
+{
+	size_t dots = text.find("..");
+	if (text.empty() || !isdigit(text[0]))
+	{
+		return false;
+	}
+
+	low = atoi(text.c_str());
+	high = (dots == string::npos) ? low : atoi(text.c_str() + dots + 2);
+
+	return low <= high;
+}
+
+/*
+	Larger than Life, R<radius>,C<states>,M<0|1>,S<a>..<b>,B<c>..<d>,N<M>.
+	Only two states and the square (Moore) neighborhood are supported.
+*/
+static bool parseLargerThanLife(const string& text, LifeRule& rule)
+{
+	int radius = -1;
+	int states = 0;
+	int middle = 0;
+	int survivalLow = 1, survivalHigh = 0;
+	int birthLow = 1, birthHigh = 0;
+	bool sawSurvival = false;
+	bool sawBirth = false;
+
+	size_t start = 0;
+	while (start < text.size())
+	{
+		size_t comma = text.find(',', start);
+		if (comma == string::npos)
+		{
+			comma = text.size();
+		}
+
+		string field = text.substr(start, comma - start);
+		start = comma + 1;
+
+		if (field.empty())
+		{
+			continue;
+		}
+
+		char key = toupper(field[0]);
+		string value = field.substr(1);
+
+		if (key == 'R')
+		{
+			radius = atoi(value.c_str());
+		}
+		else if (key == 'C')
+		{
+			states = atoi(value.c_str());
+		}
+		else if (key == 'M')
+		{
+			middle = atoi(value.c_str());
+		}
+		else if (key == 'S')
+		{
+			sawSurvival = parseRange(value, survivalLow, survivalHigh);
+		}
+		else if (key == 'B')
+		{
+			sawBirth = parseRange(value, birthLow, birthHigh);
+		}
+		else if (key == 'N')
+		{
+			if (value != "M")
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (radius < 1 || (states != 0 && states != 2) || !sawSurvival || !sawBirth)
+	{
+		return false;
+	}
+
+	rule.radius = radius;
+	rule.maxCount = (2 * radius + 1) * (2 * radius + 1) - 1;
+
+	vector<char> birth(rule.maxCount + 1, 0);
+	vector<char> survival(rule.maxCount + 1, 0);
+
+	// with M1 a live cell counts itself, so its own count is one lower here
+	int selfCount = (middle == 1) ? 1 : 0;
+
+	for (int count = 0; count <= rule.maxCount; count++)
+	{
+		birth[count] = count >= birthLow && count <= birthHigh;
+		survival[count] = count + selfCount >= survivalLow && count + selfCount <= survivalHigh;
+	}
+
+	buildTable(rule, birth, survival);
+
+	return true;
+}
+
+bool parseRule(const char* text, LifeRule& rule)
+{
+	string ruleText = text;
+	string lower;
+	for (size_t position = 0; position < ruleText.size(); position++)
+	{
+		lower += tolower(ruleText[position]);
+	}
+
+	rule.name = ruleText;
+
+	if (lower == "life" || lower == "conway")
+	{
+		return parseBirthSurvival("B3/S23", rule);
+	}
+	if (lower == "highlife")
+	{
+		return parseBirthSurvival("B36/S23", rule);
+	}
+	if (lower == "daynight" || lower == "day&night")
+	{
+		return parseBirthSurvival("B3678/S34678", rule);
+	}
+	if (!lower.empty() && lower[0] == 'r' && lower.find(',') != string::npos)
+	{
+		return parseLargerThanLife(ruleText, rule);
+	}
+
+	return parseBirthSurvival(ruleText, rule);
+}
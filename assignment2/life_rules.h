@@ -0,0 +1,76 @@
+#ifndef BK_LIFE_RULES_H
+#define BK_LIFE_RULES_H
+
+#include <string>
+#include <vector>
+
+/*
+	Rules for Life-like cellular automata.  A rule says, for a dead cell and
+	for a live cell, which neighbor counts make the cell alive next generation.
+	The neighborhood is the (2r+1) x (2r+1) square around the cell, r = 1 being
+	the usual 8 neighbors.
+*/
+
+struct LifeRule
+{
+	std::string name;
+
+	int radius;
+
+	// largest possible neighbor count, not counting the cell itself
+	int maxCount;
+
+	// next state, table[state * (maxCount + 1) + count]
+	std::vector<unsigned char> table;
+
+	// radius 1 only: bit n of birthMask / survivalMask is set when n neighbors
+	// give birth / keep a live cell alive
+	unsigned int birthMask;
+	unsigned int survivalMask;
+};
+
+// understands B3/S23, the old 23/3 (survival/birth) notation, the names
+// life, highlife and daynight, and Larger than Life rules like
+// R5,C0,M1,S34..58,B34..45,NM.  Returns false for anything else.
+bool parseRule(const char* text, LifeRule& rule);
+
+// radius 1 rules as one 18 bit lookup table: bit (state * 9 + count) is the next state
+inline unsigned int mooreTable(unsigned int birthMask, unsigned int survivalMask)
+{
+	return birthMask | (survivalMask << 9);
+}
+
+/*
+	A radius 1 rule fixed at compile time.  The transition is a shift of a
+	constant, so the kernel it is plugged into has no branches in it.
+*/
+template <unsigned int BirthMask, unsigned int SurvivalMask>
+struct MooreRule
+{
+	static const unsigned int TABLE = BirthMask | (SurvivalMask << 9);
+
+	inline int next(int state, int count) const
+	{
+		return (TABLE >> (state * 9 + count)) & 1;
+	}
+};
+
+// B3/S23, B36/S23 and B3678/S34678
+typedef MooreRule<(1 << 3), (1 << 2) | (1 << 3)> ConwayRule;
+typedef MooreRule<(1 << 3) | (1 << 6), (1 << 2) | (1 << 3)> HighLifeRule;
+typedef MooreRule<(1 << 3) | (1 << 6) | (1 << 7) | (1 << 8), (1 << 3) | (1 << 4) | (1 << 6) | (1 << 7) | (1 << 8)> DayAndNightRule;
+
+// any other radius 1 rule, with the same table read at run time
+struct RuntimeMooreRule
+{
+	unsigned int table;
+
+	RuntimeMooreRule(const LifeRule& rule) : table(mooreTable(rule.birthMask, rule.survivalMask)) {}
+
+	inline int next(int state, int count) const
+	{
+		return (table >> (state * 9 + count)) & 1;
+	}
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include <cstring>
+#include "life_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LIFE_SIMD_X86
+#endif
+
+/*
+The vector kernels work on 16, 32 or 64 cells of a row at a time.  Every row
+gets its horizontal sums (left + middle + right) done once, and the sums of
+the row above, the row itself and the row below add up to the 3x3 sum of
+every cell, so going down a column of vectors each row sum is used three
+times and only one new one is made per row.  The 3x3 sum includes the cell
+itself, so it goes from 0 to 9, and the next state comes out of two 16 entry
+lookup tables, one for dead cells and one for live ones.  AVX2 and AVX-512
+look them up with a byte shuffle (pshufb), SSE2 doesn't have one and compares
+against every sum instead.
+
+Every version is compiled with a target attribute instead of -mavx2 and
+friends, so the rest of the program still runs on any x86-64, and
+__builtin_cpu_supports decides which one to use.
+*/
+
+typedef int (*MooreKernel)(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed);
+
+/*
+	Next state for every 3x3 sum, the cell included.  A dead cell's sum is its
+	neighbor count, a live cell's is one more.
+*/
+static void buildLookups(unsigned int ruleTable, unsigned char* birthLookup, unsigned char* survivalLookup)
+{
+	memset(birthLookup, 0, 16);
+	memset(survivalLookup, 0, 16);
+
+	for (int count = 0; count <= 8; count++)
+	{
+		birthLookup[count] = (ruleTable >> count) & 1;
+		survivalLookup[count + 1] = (ruleTable >> (9 + count)) & 1;
+	}
+}
+
+// the scalar "kernel" does nothing, the caller's loop does all the columns
+static int scalarMooreCells(const unsigned char*, unsigned char*, int, int, int firstColumn, int, int, int, unsigned int, bool&)
+{
+	return firstColumn;
+}
+
+#ifdef LIFE_SIMD_X86
+
+__attribute__((target("sse2")))
+static inline __m128i rowSumSse2(const unsigned char* cells)
+{
+	return _mm_add_epi8(_mm_add_epi8(_mm_loadu_si128((const __m128i*)(cells - 1)), _mm_loadu_si128((const __m128i*)cells)),
+		_mm_loadu_si128((const __m128i*)(cells + 1)));
+}
+
+__attribute__((target("sse2")))
+static int sse2MooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed)
+{
+	const int WIDTH = 16;
+
+	unsigned char birthLookup[16];
+	unsigned char survivalLookup[16];
+	buildLookups(ruleTable, birthLookup, survivalLookup);
+
+	// no shuffle in SSE2, so compare against the sums that give a live cell
+	__m128i birthSums[10];
+	__m128i survivalSums[10];
+	int birthSumCount = 0;
+	int survivalSumCount = 0;
+	for (int sum = 0; sum <= 9; sum++)
+	{
+		if (birthLookup[sum])
+		{
+			birthSums[birthSumCount++] = _mm_set1_epi8(sum);
+		}
+		if (survivalLookup[sum])
+		{
+			survivalSums[survivalSumCount++] = _mm_set1_epi8(sum);
+		}
+	}
+
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i changedCells = _mm_setzero_si128();
+
+	int column = firstColumn;
+	for (; column + WIDTH <= lastColumn; column += WIDTH)
+	{
+		const unsigned char* cells = grid + (long long)(firstRow + haloDepth) * columns + column;
+		__m128i sumAbove = rowSumSse2(cells - columns);
+		__m128i sumCurrent = rowSumSse2(cells);
+
+		for (int row = firstRow; row < lastRow; row++, cells += columns)
+		{
+			__m128i sumBelow = rowSumSse2(cells + columns);
+			__m128i total = _mm_add_epi8(_mm_add_epi8(sumAbove, sumCurrent), sumBelow);
+
+			__m128i born = _mm_setzero_si128();
+			__m128i kept = _mm_setzero_si128();
+			for (int sum = 0; sum < birthSumCount; sum++)
+			{
+				born = _mm_or_si128(born, _mm_cmpeq_epi8(total, birthSums[sum]));
+			}
+			for (int sum = 0; sum < survivalSumCount; sum++)
+			{
+				kept = _mm_or_si128(kept, _mm_cmpeq_epi8(total, survivalSums[sum]));
+			}
+
+			__m128i current = _mm_loadu_si128((const __m128i*)cells);
+			__m128i alive = _mm_cmpeq_epi8(current, one);
+			__m128i next = _mm_and_si128(_mm_or_si128(_mm_and_si128(alive, kept), _mm_andnot_si128(alive, born)), one);
+
+			_mm_storeu_si128((__m128i*)(nextGrid + (long long)(row + haloDepth) * columns + column), next);
+			changedCells = _mm_or_si128(changedCells, _mm_xor_si128(next, current));
+
+			sumAbove = sumCurrent;
+			sumCurrent = sumBelow;
+		}
+	}
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(changedCells, _mm_setzero_si128())) != 0xFFFF)
+	{
+		changed = true;
+	}
+
+	return column;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rowSumAvx2(const unsigned char* cells)
+{
+	return _mm256_add_epi8(_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(cells - 1)), _mm256_loadu_si256((const __m256i*)cells)),
+		_mm256_loadu_si256((const __m256i*)(cells + 1)));
+}
+
+__attribute__((target("avx2")))
+static int avx2MooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed)
+{
+	const int WIDTH = 32;
+
+	unsigned char birthLookup[16];
+	unsigned char survivalLookup[16];
+	buildLookups(ruleTable, birthLookup, survivalLookup);
+
+	// the shuffle looks up inside each 128 bit lane, so both lanes get the table
+	const __m256i births = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)birthLookup));
+	const __m256i survivals = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)survivalLookup));
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i changedCells = _mm256_setzero_si256();
+
+	int column = firstColumn;
+	for (; column + WIDTH <= lastColumn; column += WIDTH)
+	{
+		const unsigned char* cells = grid + (long long)(firstRow + haloDepth) * columns + column;
+		__m256i sumAbove = rowSumAvx2(cells - columns);
+		__m256i sumCurrent = rowSumAvx2(cells);
+
+		for (int row = firstRow; row < lastRow; row++, cells += columns)
+		{
+			__m256i sumBelow = rowSumAvx2(cells + columns);
+			__m256i total = _mm256_add_epi8(_mm256_add_epi8(sumAbove, sumCurrent), sumBelow);
+
+			__m256i current = _mm256_loadu_si256((const __m256i*)cells);
+			__m256i alive = _mm256_cmpeq_epi8(current, one);
+			__m256i next = _mm256_blendv_epi8(_mm256_shuffle_epi8(births, total), _mm256_shuffle_epi8(survivals, total), alive);
+
+			_mm256_storeu_si256((__m256i*)(nextGrid + (long long)(row + haloDepth) * columns + column), next);
+			changedCells = _mm256_or_si256(changedCells, _mm256_xor_si256(next, current));
+
+			sumAbove = sumCurrent;
+			sumCurrent = sumBelow;
+		}
+	}
+
+	if (!_mm256_testz_si256(changedCells, changedCells))
+	{
+		changed = true;
+	}
+
+	return column;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i rowSumAvx512(const unsigned char* cells)
+{
+	return _mm512_add_epi8(_mm512_add_epi8(_mm512_loadu_si512((const void*)(cells - 1)), _mm512_loadu_si512((const void*)cells)),
+		_mm512_loadu_si512((const void*)(cells + 1)));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static int avx512MooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed)
+{
+	const int WIDTH = 64;
+
+	unsigned char birthLookup[16];
+	unsigned char survivalLookup[16];
+	buildLookups(ruleTable, birthLookup, survivalLookup);
+
+	const __m512i births = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)birthLookup));
+	const __m512i survivals = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)survivalLookup));
+	const __m512i one = _mm512_set1_epi8(1);
+	__m512i changedCells = _mm512_setzero_si512();
+
+	int column = firstColumn;
+	for (; column + WIDTH <= lastColumn; column += WIDTH)
+	{
+		const unsigned char* cells = grid + (long long)(firstRow + haloDepth) * columns + column;
+		__m512i sumAbove = rowSumAvx512(cells - columns);
+		__m512i sumCurrent = rowSumAvx512(cells);
+
+		for (int row = firstRow; row < lastRow; row++, cells += columns)
+		{
+			__m512i sumBelow = rowSumAvx512(cells + columns);
+			__m512i total = _mm512_add_epi8(_mm512_add_epi8(sumAbove, sumCurrent), sumBelow);
+
+			__m512i current = _mm512_loadu_si512((const void*)cells);
+			__mmask64 alive = _mm512_cmpeq_epi8_mask(current, one);
+			__m512i next = _mm512_mask_blend_epi8(alive, _mm512_shuffle_epi8(births, total), _mm512_shuffle_epi8(survivals, total));
+
+			_mm512_storeu_si512((void*)(nextGrid + (long long)(row + haloDepth) * columns + column), next);
+			changedCells = _mm512_or_si512(changedCells, _mm512_xor_si512(next, current));
+
+			sumAbove = sumCurrent;
+			sumCurrent = sumBelow;
+		}
+	}
+
+	if (_mm512_test_epi8_mask(changedCells, changedCells) != 0)
+	{
+		changed = true;
+	}
+
+	return column;
+}
+
+#endif
+
+static MooreKernel mooreKernel = scalarMooreCells;
+static const char* mooreKernelInUse = "scalar";
+
+bool selectMooreKernel(const char* name)
+{
+	bool automatic = strcmp(name, "auto") == 0;
+
+#ifdef LIFE_SIMD_X86
+	__builtin_cpu_init();
+
+	if ((automatic || strcmp(name, "avx512") == 0) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+	{
+		mooreKernel = avx512MooreCells;
+		mooreKernelInUse = "avx512";
+		return true;
+	}
+	if ((automatic || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+	{
+		mooreKernel = avx2MooreCells;
+		mooreKernelInUse = "avx2";
+		return true;
+	}
+	if ((automatic || strcmp(name, "sse2") == 0) && __builtin_cpu_supports("sse2"))
+	{
+		mooreKernel = sse2MooreCells;
+		mooreKernelInUse = "sse2";
+		return true;
+	}
+#endif
+
+	if (automatic || strcmp(name, "scalar") == 0)
+	{
+		mooreKernel = scalarMooreCells;
+		mooreKernelInUse = "scalar";
+		return true;
+	}
+
+	return false;
+}
+
+const char* mooreKernelName()
+{
+	return mooreKernelInUse;
+}
+
+int vectorMooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed)
+{
+	return mooreKernel(grid, nextGrid, firstRow, lastRow, firstColumn, lastColumn, columns, haloDepth, ruleTable, changed);
+}
@@ -0,0 +1,25 @@
+#ifndef BK_LIFE_SIMD_H
+#define BK_LIFE_SIMD_H
+
+/*
+	Vector versions of the radius 1 kernel for a board with one byte per cell.
+	The build has an SSE2, an AVX2 and an AVX-512 version, and the widest one
+	the CPU can run is picked when the program starts.
+*/
+
+// auto picks the widest one this CPU has, the others are scalar, sse2, avx2
+// and avx512.  Returns false if the name is unknown or the CPU can't run it.
+// Call it once before any kernel runs.
+bool selectMooreKernel(const char* name);
+
+// name of the kernel in use
+const char* mooreKernelName();
+
+// computes block rows [firstRow, lastRow) and columns [firstColumn, lastColumn)
+// of a radius 1 rule (ruleTable is mooreTable in life_rules.h), as many whole
+// vectors as fit.  The columns may not wrap around, so 1 <= firstColumn and
+// lastColumn <= columns - 1.  Returns the first column that was not done,
+// and sets changed if any cell that was done changed.
+int vectorMooreCells(const unsigned char* grid, unsigned char* nextGrid, int firstRow, int lastRow, int firstColumn, int lastColumn, int columns, int haloDepth, unsigned int ruleTable, bool& changed);
+
+#endif
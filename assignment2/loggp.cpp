@@ -0,0 +1,779 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+
+/*
+This program fits the LogGP model to ping pong results, so the time of a
+message can be predicted without running anything.  In LogGP a message of k
+bytes takes L + 2o + (k - 1)G one way (latency, the overhead on both ends,
+and the gap per byte), and messages sent back to back go out every g + (k -
+1)G.  Both are a straight line in k, so every version at every host pair
+gets a line through its times: for the round trip versions the intercept is
+L + 2o and for the streaming ones (stream, bistream) it is the gap g, and
+the slope is G either way.  The fit is weighted least squares with the
+weights one over the time squared, so that every size counts by its
+relative error instead of the largest ones deciding everything.  None of
+the parameters can be below 0, so when the best line has a negative
+intercept or slope the best line with that one at 0 is taken instead.  MPI
+changes protocol somewhere (eager to rendezvous), so there is also the best
+fit with two lines, one for the sizes below a switch and one from the
+switch on, and the size where the switch is.  Two points always fit a line
+exactly, so each side needs at least three sizes, and the two lines are
+only kept if they beat the one line by the Bayesian information criterion
+(five parameters against two), otherwise the switch is 0.
+
+A round trip alone can't tell L from o, that takes the ping_pong -overlap
+sweep.  There the kernel takes about as long as the round trip, so what is
+left of together_us after compute_us is rank 0's own work, the send
+overhead before computing and the receive overhead after, and half of it
+is o.  Those go into an "overhead" series fitted like the others, and its
+intercept gives every round trip line of the same host pair an o and an L
+(L + 2o minus 2o).  If MPI doesn't move the message while rank 0 computes,
+less of the round trip hides and o comes out too big, and L too small.
+
+It reads every kind of output in one pass, files or standard input, with
+the kinds mixed if need be:
+	the old ping_pong output (pingpongresults.txt), a line "Normal at 2 bytes"
+	and then one-way times in milliseconds, one per line;
+	the CSV of the ping_pong sweep, -overlap, -oneWay and -allPairs, the
+	header line saying which;
+	the same as JSON lines.
+Lines it doesn't know are counted and skipped.  Nothing but a sum, a count
+and a minimum per version, host pair and size is kept, so a file of any
+length takes the same memory.  The times at a size are boiled down to their
+mean (-statistic min for the minimum, which ignores the noise).  Results
+that don't say which hosts they are from go under -pair (default
+"unknown"), and -allPairs results go under their two hostnames.
+
+-predict <bytes> adds the predicted one-way time of a message of that many
+bytes for every round trip and one-way line, for working out what the halo
+rows of life.cpp or the blocks of mpi_odd_even.c will cost.  It uses the
+two lines when there is a switch and the one line when there isn't.  The
+stream, bistream and overhead lines are no one-way time and get none.
+*/
+
+using namespace std;
+
+// one message size of one series, times in microseconds
+struct SizePoint
+{
+	long long bytes;
+	long long samples;
+	double sum;
+	double minimum;
+};
+
+// the most sizes kept per series, doubling from 1 byte to 2^63 is 64
+const int MAX_SIZES = 96;
+
+struct Series
+{
+	string mode;
+	string pair;
+	int sizeCount;
+	long long samples;
+	SizePoint sizes[MAX_SIZES];
+};
+
+// a line y = intercept + slope * bytes and how well it fits
+struct LineFit
+{
+	double intercept;
+	double slope;
+	double r2;
+	double error;
+	int points;
+};
+
+// where the data lines that follow a CSV header keep their columns
+struct CsvLayout
+{
+	int kind;
+	map<string, int> columns;
+};
+
+const int LAYOUT_NONE = 0;
+const int LAYOUT_SWEEP = 1;
+const int LAYOUT_ONE_WAY = 2;
+const int LAYOUT_ALL_PAIRS = 3;
+const int LAYOUT_OVERLAP = 4;
+
+// the fewest sizes on each side of a switch
+const int MIN_SIDE_SIZES = 3;
+
+void printUsage();
+void addSample(map<string, Series>& series, const string& mode, const string& pair, long long bytes, double microseconds, long long& droppedSizes);
+bool parseOldHeader(const string& line, string& mode, long long& bytes);
+bool isNumber(const string& text);
+vector<string> splitCsv(const string& line);
+bool jsonField(const string& line, const char* name, string& value);
+bool parseLine(const string& line, CsvLayout& layout, string& oldMode, long long& oldBytes, const string& defaultPair, map<string, Series>& series, long long& droppedSizes);
+bool smallerSize(const SizePoint& a, const SizePoint& b);
+double overheadSample(double computeMicroseconds, double togetherMicroseconds);
+double informationCriterion(double error, int points, int parameters);
+void scoreFit(const vector<double>& bytes, const vector<double>& times, int first, int last, LineFit& fit);
+LineFit fitLine(const vector<double>& bytes, const vector<double>& times, int first, int last);
+void seriesTimes(const Series& current, bool useMinimum, vector<SizePoint>& points, vector<double>& bytes, vector<double>& times);
+void writeFits(ostream& out, bool json, map<string, Series>& series, bool useMinimum, long long predictBytes);
+
+int main(int argc, char *argv[])
+{
+	bool useMinimum = false;
+	bool json = false;
+	string defaultPair = "unknown";
+	long long predictBytes = -1;
+	vector<const char*> files;
+
+	for (int argument = 1; argument < argc; argument++)
+	{
+		if (strcmp(argv[argument], "-statistic") == 0 && argument + 1 < argc
+			&& (strcmp(argv[argument + 1], "mean") == 0 || strcmp(argv[argument + 1], "min") == 0))
+		{
+			argument++;
+			useMinimum = strcmp(argv[argument], "min") == 0;
+		}
+		else if (strcmp(argv[argument], "-pair") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			defaultPair = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-predict") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			predictBytes = atoll(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-format") == 0 && argument + 1 < argc
+			&& (strcmp(argv[argument + 1], "csv") == 0 || strcmp(argv[argument + 1], "json") == 0))
+		{
+			argument++;
+			json = strcmp(argv[argument], "json") == 0;
+		}
+		else if (argv[argument][0] == '-' && argv[argument][1] != '\0')
+		{
+			printUsage();
+			exit(1);
+		}
+		else
+		{
+			files.push_back(argv[argument]);
+		}
+	}
+
+	map<string, Series> series;
+	long long skippedLines = 0;
+	long long droppedSizes = 0;
+
+	// no files, or "-", is standard input
+	if (files.empty())
+	{
+		files.push_back("-");
+	}
+
+	for (size_t file = 0; file < files.size(); file++)
+	{
+		ifstream input;
+		bool standardInput = strcmp(files[file], "-") == 0;
+		if (!standardInput)
+		{
+			input.open(files[file]);
+			if (!input)
+			{
+				cerr << "Could not open " << files[file] << endl;
+				exit(1);
+			}
+		}
+		istream& in = standardInput ? cin : input;
+
+		// every file starts over, a CSV header or old header doesn't carry over
+		CsvLayout layout;
+		layout.kind = LAYOUT_NONE;
+		string oldMode;
+		long long oldBytes = -1;
+
+		string line;
+		while (getline(in, line))
+		{
+			if (!line.empty() && line[line.size() - 1] == '\r')
+			{
+				line.erase(line.size() - 1);
+			}
+			if (line.empty())
+			{
+				continue;
+			}
+			if (!parseLine(line, layout, oldMode, oldBytes, defaultPair, series, droppedSizes))
+			{
+				skippedLines++;
+			}
+		}
+	}
+
+	writeFits(cout, json, series, useMinimum, predictBytes);
+
+	if (skippedLines > 0)
+	{
+		cerr << "Skipped " << skippedLines << " lines that weren't results" << endl;
+	}
+	if (droppedSizes > 0)
+	{
+		cerr << "Dropped " << droppedSizes << " samples of series with more than " << MAX_SIZES << " sizes" << endl;
+	}
+}
+
+void printUsage()
+{
+	cout << "Usage: ./loggp [options] [result files, - or none for standard input]" << endl;
+	cout << "Options:" << endl;
+	cout << "  -statistic mean|min   what the times at one size are boiled down to (default mean)" << endl;
+	cout << "  -pair <name>          host pair of the results that don't say (default unknown)" << endl;
+	cout << "  -predict <bytes>      also predict the one-way time of a message this big (round trip and one-way lines)" << endl;
+	cout << "  -format csv|json      one CSV row or one JSON object per fit (default csv)" << endl;
+}
+
+void addSample(map<string, Series>& series, const string& mode, const string& pair, long long bytes, double microseconds, long long& droppedSizes)
+{
+	if (bytes < 1 || !(microseconds >= 0))
+	{
+		return;
+	}
+
+	string key = mode + "\t" + pair;
+	map<string, Series>::iterator found = series.find(key);
+	if (found == series.end())
+	{
+		Series fresh;
+		fresh.mode = mode;
+		fresh.pair = pair;
+		fresh.sizeCount = 0;
+		fresh.samples = 0;
+		found = series.insert(make_pair(key, fresh)).first;
+	}
+	Series& current = found->second;
+
+	int size = 0;
+	while (size < current.sizeCount && current.sizes[size].bytes != bytes)
+	{
+		size++;
+	}
+	if (size == current.sizeCount)
+	{
+		if (current.sizeCount == MAX_SIZES)
+		{
+			droppedSizes++;
+			return;
+		}
+		current.sizes[size].bytes = bytes;
+		current.sizes[size].samples = 0;
+		current.sizes[size].sum = 0;
+		current.sizes[size].minimum = microseconds;
+		current.sizeCount++;
+	}
+
+	SizePoint& point = current.sizes[size];
+	point.samples++;
+	point.sum += microseconds;
+	point.minimum = min(point.minimum, microseconds);
+	current.samples++;
+}
+
+/*
+	"Normal at 2 bytes", "SendRecv at 2 bytes", "Non Blocking at 2 bytes"
+	(or "Nonblocking").  The mode comes out the way ping_pong names it now:
+	lower case, no spaces.
+*/
+bool parseOldHeader(const string& line, string& mode, long long& bytes)
+{
+	size_t at = line.find(" at ");
+	if (at == string::npos || line.size() < 6 || line.compare(line.size() - 6, 6, " bytes") != 0)
+	{
+		return false;
+	}
+
+	string size = line.substr(at + 4, line.size() - 6 - (at + 4));
+	if (!isNumber(size))
+	{
+		return false;
+	}
+
+	mode.clear();
+	for (size_t i = 0; i < at; i++)
+	{
+		if (line[i] != ' ')
+		{
+			mode += (char)tolower(line[i]);
+		}
+	}
+	bytes = atoll(size.c_str());
+	return !mode.empty();
+}
+
+bool isNumber(const string& text)
+{
+	if (text.empty())
+	{
+		return false;
+	}
+	char* end;
+	strtod(text.c_str(), &end);
+	return *end == '\0';
+}
+
+vector<string> splitCsv(const string& line)
+{
+	vector<string> fields;
+	size_t start = 0;
+	while (true)
+	{
+		size_t comma = line.find(',', start);
+		fields.push_back(line.substr(start, comma - start));
+		if (comma == string::npos)
+		{
+			return fields;
+		}
+		start = comma + 1;
+	}
+}
+
+/*
+	The value of "name" in a flat JSON object on one line, the way ping_pong
+	writes them, without the quotes if it is a string.
+*/
+bool jsonField(const string& line, const char* name, string& value)
+{
+	string key = string("\"") + name + "\":";
+	size_t position = line.find(key);
+	if (position == string::npos)
+	{
+		return false;
+	}
+	position += key.size();
+	while (position < line.size() && line[position] == ' ')
+	{
+		position++;
+	}
+
+	if (position < line.size() && line[position] == '"')
+	{
+		size_t end = line.find('"', position + 1);
+		if (end == string::npos)
+		{
+			return false;
+		}
+		value = line.substr(position + 1, end - position - 1);
+		return true;
+	}
+
+	size_t end = line.find_first_of(",}", position);
+	value = line.substr(position, end - position);
+	while (!value.empty() && value[value.size() - 1] == ' ')
+	{
+		value.erase(value.size() - 1);
+	}
+	return !value.empty();
+}
+
+/*
+	One line of input.  Returns false if it wasn't anything this knows.  An
+	old header or CSV header changes how the lines after it are read.
+*/
+bool parseLine(const string& line, CsvLayout& layout, string& oldMode, long long& oldBytes, const string& defaultPair, map<string, Series>& series, long long& droppedSizes)
+{
+	string mode;
+	long long bytes;
+
+	if (parseOldHeader(line, mode, bytes))
+	{
+		oldMode = mode;
+		oldBytes = bytes;
+		layout.kind = LAYOUT_NONE;
+		return true;
+	}
+
+	if (isNumber(line))
+	{
+		if (oldBytes < 0)
+		{
+			return false;
+		}
+		// the old output is in milliseconds
+		addSample(series, oldMode, defaultPair, oldBytes, atof(line.c_str()) * 1000, droppedSizes);
+		return true;
+	}
+
+	if (line[0] == '{')
+	{
+		string value;
+		string secondValue;
+		string hostA;
+		string hostB;
+
+		if (jsonField(line, "mode", mode) && jsonField(line, "bytes", value) && jsonField(line, "median_us", secondValue))
+		{
+			addSample(series, mode, defaultPair, atoll(value.c_str()), atof(secondValue.c_str()), droppedSizes);
+			return true;
+		}
+		if (jsonField(line, "together_us", secondValue) && jsonField(line, "compute_us", hostA) && jsonField(line, "bytes", value))
+		{
+			addSample(series, "overhead", defaultPair, atoll(value.c_str()), overheadSample(atof(hostA.c_str()), atof(secondValue.c_str())), droppedSizes);
+			return true;
+		}
+		if (jsonField(line, "forward_median_us", secondValue) && jsonField(line, "bytes", value))
+		{
+			addSample(series, "forward", defaultPair, atoll(value.c_str()), atof(secondValue.c_str()), droppedSizes);
+			if (jsonField(line, "backward_median_us", secondValue))
+			{
+				addSample(series, "backward", defaultPair, atoll(value.c_str()), atof(secondValue.c_str()), droppedSizes);
+			}
+			return true;
+		}
+		if (jsonField(line, "host_a", hostA) && jsonField(line, "host_b", hostB))
+		{
+			string latencyBytes, latency, bandwidthBytes, bandwidth;
+			if (jsonField(line, "latency_bytes", latencyBytes) && jsonField(line, "latency_us", latency)
+				&& jsonField(line, "bandwidth_bytes", bandwidthBytes) && jsonField(line, "bandwidth_MBps", bandwidth))
+			{
+				string pair = hostA + "-" + hostB;
+				addSample(series, "normal", pair, atoll(latencyBytes.c_str()), atof(latency.c_str()), droppedSizes);
+				// MB/s are bytes per microsecond
+				double megabytes = atof(bandwidth.c_str());
+				if (megabytes > 0)
+				{
+					addSample(series, "normal", pair, atoll(bandwidthBytes.c_str()), atoll(bandwidthBytes.c_str()) / megabytes, droppedSizes);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	vector<string> fields = splitCsv(line);
+
+	// a header line: which kind of CSV, and where the columns are
+	if (!fields.empty() && !isNumber(fields[0]) && (fields[0] == "mode" || fields[0] == "bytes" || fields[0] == "rank_a"))
+	{
+		layout.columns.clear();
+		for (size_t column = 0; column < fields.size(); column++)
+		{
+			layout.columns[fields[column]] = column;
+		}
+
+		if (fields[0] == "mode" && layout.columns.count("median_us"))
+		{
+			layout.kind = LAYOUT_SWEEP;
+		}
+		else if (fields[0] == "bytes" && layout.columns.count("forward_median_us"))
+		{
+			layout.kind = LAYOUT_ONE_WAY;
+		}
+		else if (fields[0] == "bytes" && layout.columns.count("together_us") && layout.columns.count("compute_us"))
+		{
+			layout.kind = LAYOUT_OVERLAP;
+		}
+		else if (fields[0] == "rank_a" && layout.columns.count("bandwidth_MBps"))
+		{
+			layout.kind = LAYOUT_ALL_PAIRS;
+		}
+		else
+		{
+			layout.kind = LAYOUT_NONE;
+		}
+		oldBytes = -1;
+		return layout.kind != LAYOUT_NONE;
+	}
+
+	if (layout.kind == LAYOUT_NONE || fields.size() < layout.columns.size())
+	{
+		return false;
+	}
+
+	map<string, int>& columns = layout.columns;
+	if (layout.kind == LAYOUT_SWEEP)
+	{
+		addSample(series, fields[columns["mode"]], defaultPair, atoll(fields[columns["bytes"]].c_str()), atof(fields[columns["median_us"]].c_str()), droppedSizes);
+	}
+	else if (layout.kind == LAYOUT_ONE_WAY)
+	{
+		bytes = atoll(fields[columns["bytes"]].c_str());
+		addSample(series, "forward", defaultPair, bytes, atof(fields[columns["forward_median_us"]].c_str()), droppedSizes);
+		addSample(series, "backward", defaultPair, bytes, atof(fields[columns["backward_median_us"]].c_str()), droppedSizes);
+	}
+	else if (layout.kind == LAYOUT_OVERLAP)
+	{
+		double together = atof(fields[columns["together_us"]].c_str());
+		double compute = atof(fields[columns["compute_us"]].c_str());
+		addSample(series, "overhead", defaultPair, atoll(fields[columns["bytes"]].c_str()), overheadSample(compute, together), droppedSizes);
+	}
+	else
+	{
+		string pair = fields[columns["host_a"]] + "-" + fields[columns["host_b"]];
+		addSample(series, "normal", pair, atoll(fields[columns["latency_bytes"]].c_str()), atof(fields[columns["latency_us"]].c_str()), droppedSizes);
+
+		long long bandwidthBytes = atoll(fields[columns["bandwidth_bytes"]].c_str());
+		double megabytes = atof(fields[columns["bandwidth_MBps"]].c_str());
+		if (megabytes > 0)
+		{
+			addSample(series, "normal", pair, bandwidthBytes, bandwidthBytes / megabytes, droppedSizes);
+		}
+	}
+	return true;
+}
+
+bool smallerSize(const SizePoint& a, const SizePoint& b)
+{
+	return a.bytes < b.bytes;
+}
+
+/*
+	o from one size of the -overlap sweep: the part of the round trip that
+	didn't hide behind the kernel is the send and the receive overhead of
+	rank 0.  Noise can make it a little negative, which is no overhead.
+*/
+double overheadSample(double computeMicroseconds, double togetherMicroseconds)
+{
+	return max(0.0, togetherMicroseconds - computeMicroseconds) / 2;
+}
+
+/*
+	error (the weighted sum of squared residuals) and r2 of fit through
+	points [first, last).
+*/
+void scoreFit(const vector<double>& bytes, const vector<double>& times, int first, int last, LineFit& fit)
+{
+	double sumW = 0, sumY = 0;
+	for (int i = first; i < last; i++)
+	{
+		double weight = (times[i] > 0) ? 1 / (times[i] * times[i]) : 1;
+		sumW += weight;
+		sumY += weight * times[i];
+	}
+
+	double meanY = (sumW > 0) ? sumY / sumW : 0;
+	double residuals = 0, total = 0;
+	for (int i = first; i < last; i++)
+	{
+		double weight = (times[i] > 0) ? 1 / (times[i] * times[i]) : 1;
+		double predicted = fit.intercept + fit.slope * bytes[i];
+		residuals += weight * (times[i] - predicted) * (times[i] - predicted);
+		total += weight * (times[i] - meanY) * (times[i] - meanY);
+	}
+	fit.error = residuals;
+	fit.r2 = (total > 0) ? 1 - residuals / total : 1;
+}
+
+/*
+	BIC of a fit with a weighted sum of squared residuals error.  The error is
+	relative, so it is floored at a millionth of every time to keep data that
+	is already a perfect line from choosing between two rounding errors.
+*/
+double informationCriterion(double error, int points, int parameters)
+{
+	double floor = points * 1e-12;
+	return points * log(max(error, floor) / points) + parameters * log((double)points);
+}
+
+/*
+	Weighted least squares through points [first, last), weights one over
+	the time squared, with the intercept and the slope both at least 0.
+	When the best line breaks one of those, the best one is on the edge: a
+	flat line (slope 0) or one through 0 (intercept 0), whichever fits
+	better.  error is the weighted sum of squared residuals, which is what
+	the two line fit adds up to pick its switch.
+*/
+LineFit fitLine(const vector<double>& bytes, const vector<double>& times, int first, int last)
+{
+	double sumW = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+	for (int i = first; i < last; i++)
+	{
+		double weight = (times[i] > 0) ? 1 / (times[i] * times[i]) : 1;
+		sumW += weight;
+		sumX += weight * bytes[i];
+		sumY += weight * times[i];
+		sumXX += weight * bytes[i] * bytes[i];
+		sumXY += weight * bytes[i] * times[i];
+	}
+
+	LineFit fit;
+	fit.points = last - first;
+
+	// the flat line, times are never below 0 so neither is their mean
+	LineFit flat = fit;
+	flat.slope = 0;
+	flat.intercept = (sumW > 0) ? sumY / sumW : 0;
+	scoreFit(bytes, times, first, last, flat);
+
+	double spread = sumW * sumXX - sumX * sumX;
+	if (fit.points < 2 || spread <= 0)
+	{
+		return flat;
+	}
+
+	fit.slope = (sumW * sumXY - sumX * sumY) / spread;
+	fit.intercept = (sumY - fit.slope * sumX) / sumW;
+	if (fit.slope >= 0 && fit.intercept >= 0)
+	{
+		scoreFit(bytes, times, first, last, fit);
+		return fit;
+	}
+
+	LineFit throughZero = fit;
+	throughZero.intercept = 0;
+	throughZero.slope = (sumXX > 0) ? max(0.0, sumXY / sumXX) : 0;
+	scoreFit(bytes, times, first, last, throughZero);
+
+	return (throughZero.error < flat.error) ? throughZero : flat;
+}
+
+/*
+	The sizes of a series from smallest to largest, so the two line fit can
+	split them in order, and the time at each.
+*/
+void seriesTimes(const Series& current, bool useMinimum, vector<SizePoint>& points, vector<double>& bytes, vector<double>& times)
+{
+	points.assign(current.sizes, current.sizes + current.sizeCount);
+	sort(points.begin(), points.end(), smallerSize);
+
+	bytes.resize(points.size());
+	times.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		bytes[i] = points[i].bytes;
+		times[i] = useMinimum ? points[i].minimum : points[i].sum / points[i].samples;
+	}
+}
+
+/*
+	One line per version and host pair.  Intercepts in microseconds, G in
+	nanoseconds per byte, and the bandwidth 1 / G in MB/s.  o and L are only
+	there for round trip lines of a host pair with -overlap results.
+*/
+void writeFits(ostream& out, bool json, map<string, Series>& series, bool useMinimum, long long predictBytes)
+{
+	if (!json)
+	{
+		out << "mode,pair,sizes,samples,intercept,intercept_us,G_ns_per_byte,bandwidth_MBps,r2,switch_bytes,"
+			<< "small_intercept_us,small_G_ns_per_byte,large_intercept_us,large_G_ns_per_byte,o_us,L_us";
+		if (predictBytes > 0)
+		{
+			out << ",predict_bytes,predict_us";
+		}
+		out << endl;
+	}
+
+	vector<SizePoint> points;
+	vector<double> bytes;
+	vector<double> times;
+
+	// o of every host pair that has -overlap results
+	map<string, double> overheads;
+	for (map<string, Series>::iterator entry = series.begin(); entry != series.end(); ++entry)
+	{
+		if (entry->second.mode == "overhead")
+		{
+			seriesTimes(entry->second, useMinimum, points, bytes, times);
+			overheads[entry->second.pair] = fitLine(bytes, times, 0, points.size()).intercept;
+		}
+	}
+
+	for (map<string, Series>::iterator entry = series.begin(); entry != series.end(); ++entry)
+	{
+		Series& current = entry->second;
+		seriesTimes(current, useMinimum, points, bytes, times);
+
+		int count = points.size();
+		LineFit whole = fitLine(bytes, times, 0, count);
+
+		// the best switch leaves at least MIN_SIDE_SIZES sizes on each side
+		int bestSwitch = -1;
+		LineFit small = whole;
+		LineFit large = whole;
+		for (int split = MIN_SIDE_SIZES; split <= count - MIN_SIDE_SIZES; split++)
+		{
+			LineFit below = fitLine(bytes, times, 0, split);
+			LineFit above = fitLine(bytes, times, split, count);
+			if (bestSwitch < 0 || below.error + above.error < small.error + large.error)
+			{
+				bestSwitch = split;
+				small = below;
+				large = above;
+			}
+		}
+
+		// two lines and a switch have to be worth their three extra parameters
+		if (bestSwitch > 0 && informationCriterion(small.error + large.error, count, 5) >= informationCriterion(whole.error, count, 2))
+		{
+			bestSwitch = -1;
+			small = whole;
+			large = whole;
+		}
+
+		bool streaming = current.mode == "stream" || current.mode == "bistream";
+		bool overhead = current.mode == "overhead";
+		const char* intercept = streaming ? "g" : (overhead ? "o" : "L+2o");
+
+		// L is what is left of L + 2o, and can't be less than nothing
+		bool knowOverhead = !streaming && !overhead && overheads.count(current.pair) > 0;
+		double o = knowOverhead ? overheads[current.pair] : 0;
+		double latency = knowOverhead ? max(0.0, whole.intercept - 2 * o) : 0;
+		double bandwidth = (whole.slope > 0) ? 1 / whole.slope : 0;
+		long long switchBytes = (bestSwitch > 0) ? points[bestSwitch].bytes : 0;
+
+		// a g + kG or an o is not a one-way time, those lines get no prediction
+		bool predicting = predictBytes > 0 && !streaming && !overhead;
+		double predicted = 0;
+		if (predicting)
+		{
+			const LineFit& model = (bestSwitch > 0) ? ((predictBytes < switchBytes) ? small : large) : whole;
+			predicted = model.intercept + model.slope * predictBytes;
+		}
+
+		out << fixed << setprecision(4);
+		if (json)
+		{
+			out << "{\"mode\": \"" << current.mode << "\", \"pair\": \"" << current.pair << "\", \"sizes\": " << count << ", \"samples\": " << current.samples
+				<< ", \"intercept\": \"" << intercept << "\", \"intercept_us\": " << whole.intercept << ", \"G_ns_per_byte\": " << whole.slope * 1000
+				<< ", \"bandwidth_MBps\": " << bandwidth << ", \"r2\": " << whole.r2 << ", \"switch_bytes\": " << switchBytes
+				<< ", \"small_intercept_us\": " << small.intercept << ", \"small_G_ns_per_byte\": " << small.slope * 1000
+				<< ", \"large_intercept_us\": " << large.intercept << ", \"large_G_ns_per_byte\": " << large.slope * 1000;
+			if (knowOverhead)
+			{
+				out << ", \"o_us\": " << o << ", \"L_us\": " << latency;
+			}
+			if (predicting)
+			{
+				out << ", \"predict_bytes\": " << predictBytes << ", \"predict_us\": " << predicted;
+			}
+			out << "}" << endl;
+		}
+		else
+		{
+			out << current.mode << "," << current.pair << "," << count << "," << current.samples << "," << intercept << "," << whole.intercept << ","
+				<< whole.slope * 1000 << "," << bandwidth << "," << whole.r2 << "," << switchBytes << "," << small.intercept << ","
+				<< small.slope * 1000 << "," << large.intercept << "," << large.slope * 1000 << ",";
+			if (knowOverhead)
+			{
+				out << o << "," << latency;
+			}
+			else
+			{
+				out << ",";
+			}
+			if (predicting)
+			{
+				out << "," << predictBytes << "," << predicted;
+			}
+			else if (predictBytes > 0)
+			{
+				out << ",,";
+			}
+			out << endl;
+		}
+	}
+}
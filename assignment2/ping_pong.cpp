@@ -6,160 +6,1856 @@
 #include <chrono>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "clock_sync.h"
 
 /*
-This program is a test of the networks bandwidth by using a ping pong program to time when a 
-message is sent to another machine and then when the other machine sends that message back.  
-Dr. Karlsson wanted us to implement blocking, sendrecv, and nonblocking versions of the ping-pong algorithm.  
-This program consists of four functions including main.  The other three are the different implementations 
-of the ping-pong program.  The first function called “normal” or “regular” is the normal blocking implementation 
-of the ping-pong program.  The second function called “sendrecv” is the SendRecv version of the program.  
-The final function called “nonblocking” is what I believe to be the non-blocking version of the ping pong program.  
+This program is a test of the networks bandwidth by using a ping pong program to time when a
+message is sent to another machine and then when the other machine sends that message back.
+Dr. Karlsson wanted us to implement blocking, sendrecv, and nonblocking versions of the ping-pong algorithm.
+This program consists of four functions including main.  The other three are the different implementations
+of the ping-pong program.  The first function called “normal” or “regular” is the normal blocking implementation
+of the ping-pong program.  The second function called “sendrecv” is the SendRecv version of the program.
+The final function called “nonblocking” is what I believe to be the non-blocking version of the ping pong program.
+
+Instead of one 64 byte round trip per version, every version now goes
+through a sweep of message sizes, doubling from -sizes min to max.  At every
+size a version gets -warmup round trips that aren't timed (so connections
+are set up and caches are warm) and then -iterations timed ones.  Rank 0
+sorts the times and writes one line per version and size with the min,
+median, 99th percentile and max one-way latency (half a round trip) and the
+bandwidth at the median, as CSV or as JSON lines (-format), to the screen or
+to -output.
+
+The messages come out of two buffers, one to send from and one to receive
+into, that are allocated once on the heap for the largest size, aligned to
+a page (or to a 2 MB huge page with -hugePages) and written to all the way
+through before anything is timed, so no round trip pays for page faults.
+Messages over 2 GB don't fit an int count, so they go out as one element of
+a datatype made of 1 GB pieces.  The send buffer holds a pattern that
+depends on the size, and after the timed round trips rank 0 checks that the
+message came back with the same pattern.
+
+The nonblocking version used to stop the clock right after posting the
+MPI_Irecv, so it timed a send and a post instead of a round trip.  Now rank 0
+posts the receive and the send together and stops the clock after MPI_Waitall
+on both.  -overlap runs a different sweep that asks how much of a
+nonblocking round trip can hide behind computing: at every size it times the
+round trip alone, a made up compute kernel alone (sized to take about as long
+as the round trip), and the two together with the kernel running between
+posting and waiting.  The overlap is how much shorter together is than one
+after the other, as a percentage of the shorter of the two, so 100% means
+the round trip was completely hidden and 0% means it wasn't hidden at all.
+
+With one message in flight the link sits idle while the message before it
+is being acknowledged, so two more versions keep -window messages going at
+once.  "stream" has rank 0 post a window of MPI_Isends and rank 1 a window of
+MPI_Irecvs (each into its own part of the receive buffer), and once rank 1
+has them all it sends back an empty message so rank 0 knows the window is
+through.  "bistream" does the same in both directions at the same time.
+For those two the reported time is the time of a window over the number of
+messages in it (both directions for bistream), so the bandwidth is the
+sustained one and messages_per_s the message rate.  The receive buffer only
+gets so big, so at large sizes the window is cut down to what fits, and the
+window column says what was used.
+
+Everything above is between ranks 0 and 1.  -allPairs measures every pair of
+ranks instead, to find the slow links of a cluster like the one in
+open.hosts.  The pairs are scheduled like a round robin tournament: every
+round each rank plays one other rank (or sits out if the count is odd), the
+pairs of a round run at the same time since they don't share a rank, and
+after P - 1 rounds (P for an odd P) every pair has played.  The lower rank
+of a pair times blocking round trips at the smallest -sizes for the latency
+and at the largest for the bandwidth.  Rank 0 writes one line per pair with
+both ranks' hostnames, and with -matrix <prefix> also writes the P x P
+latency and bandwidth matrices, in rank order with the hostnames on the
+first line, which is what placement tools that map heavy talkers onto fast
+links take.
+
+The one-sided versions are named after the operation and the
+synchronization: put, get and accumulate, each with fence (both ranks call
+MPI_Win_fence around it), pscw (rank 1 posts, rank 0 starts and completes)
+and lock (rank 0 locks rank 1's window, and the time is of the operation and
+MPI_Win_flush).  Rank 0 puts and accumulates (MPI_BOR, so accumulating the
+pattern again leaves it alone) into a window on rank 1's receive buffer and
+gets from a window on rank 1's send buffer, and the time is of one
+operation with its synchronization, so it is one way like the others.  The
+windows are made once, over the whole buffers, on a communicator of ranks 0
+and 1 only.  -modes picks which versions run, the default is all of them.
+
+Half a round trip is only the one-way latency if both ways take equally
+long.  -oneWay syncs the clocks of all the ranks to rank 0's (clock_sync.h)
+and times the two ways of a blocking round trip separately: rank 0 notes
+when it sends, rank 1 when the message is in and when it sends it back, and
+rank 0 when the echo is in, all on rank 0's clock.  The clocks are synced
+again at every size, so the drift between them gets fitted over the run,
+and rank 1's sync error (half its best sync round trip) is reported too,
+since a one-way time is no better than that.
+
+The stencil codes send columns, which aren't contiguous in memory.
+-noncontiguous times round trips of a strided layout, -block bytes every
+stride bytes (each of -strides in turn), like a strip of columns of a row
+major grid, going out of a strided buffer on one rank and into one on the
+other and back.  It does that five ways: an MPI_Type_vector, a 2D
+MPI_Type_create_subarray of the same thing, MPI_Pack and MPI_Unpack with the
+vector type, a memcpy loop into a contiguous buffer and back out, and for
+comparison the same bytes already contiguous.  A layout that would take
+more than STRIDED_BUFFER bytes of memory is left out, and so is a stride
+shorter than a block or longer than INT_MAX.  MPI_Pack packs into the send
+buffer, which is only as big as the largest message, so a layout whose
+MPI_Pack_size is bigger than that is not packed, and rank 0 says so.
 */
 
 
 using namespace std;
 
+// one message of the sweep: bytes bytes from sendBuffer, received into
+// receiveBuffer, and sent as count elements of type.  The streaming versions
+// keep window of them in flight, message i received at receiveBuffer + i * bytes.
+// The one-sided versions use the windows on the two buffers, which only
+// ranks 0 and 1 have (pairComm is MPI_COMM_NULL on the others).
+struct Message
+{
+	char* sendBuffer;
+	char* receiveBuffer;
+	long long bytes;
+	MPI_Datatype type;
+	int count;
+	int window;
+
+	MPI_Comm pairComm;
+	MPI_Group partnerGroup;
+	MPI_Win sendWindow;
+	MPI_Win receiveWindow;
+};
+
 // MPI_Ssend and MPI_Recv
-void regular(int myRank, char* myMessage, int currentSize);
+double regular(int myRank, const Message& message);
 // MPI_SendRecv
-void sendrecv(int myRank, char* myMessage, int currentSize);
+double sendrecv(int myRank, const Message& message);
 // MPI_Isend and MPI_Irecv
-void nonblocking(int myRank, char* myMessage, int currentSize);
+double nonblocking(int myRank, const Message& message);
+// a window of MPI_Isends from rank 0 to rank 1
+double stream(int myRank, const Message& message);
+// a window of MPI_Isends each way at the same time
+double bistream(int myRank, const Message& message);
+// MPI_Put, MPI_Get and MPI_Accumulate with fence, post-start-complete-wait
+// and lock/flush synchronization
+double putFence(int myRank, const Message& message);
+double putPscw(int myRank, const Message& message);
+double putLock(int myRank, const Message& message);
+double getFence(int myRank, const Message& message);
+double getPscw(int myRank, const Message& message);
+double getLock(int myRank, const Message& message);
+double accumulateFence(int myRank, const Message& message);
+double accumulatePscw(int myRank, const Message& message);
+double accumulateLock(int myRank, const Message& message);
+
+// a version of the ping pong: one round trip (or window) of the message
+// between ranks 0 and 1, returns the time per message one way in seconds on
+// rank 0
+typedef double (*PingPongMode)(int myRank, const Message& message);
+
+// one nonblocking round trip with rank 0 running computeSteps steps of the
+// compute kernel between posting and waiting, returns the whole round trip
+// time in seconds on rank 0
+double overlapped(int myRank, const Message& message, long long computeSteps);
+
+// a blocking round trip between me and partner, the leader sends first and
+// gets the one-way time in seconds
+double pairRoundTrip(int partner, bool leader, const Message& message);
+
+// which of ranks 0 and 1 end up with the message in their receive buffer
+const int RECEIVED_ON_0 = 1;
+const int RECEIVED_ON_1 = 2;
+const int RECEIVED_ON_BOTH = RECEIVED_ON_0 | RECEIVED_ON_1;
+
+// windowed versions fill window parts of the receive buffer
+struct ModeEntry
+{
+	const char* name;
+	PingPongMode run;
+	bool windowed;
+	int receivers;
+};
+
+const ModeEntry MODES[] = {
+	{ "normal", regular, false, RECEIVED_ON_BOTH },
+	{ "sendrecv", sendrecv, false, RECEIVED_ON_BOTH },
+	{ "nonblocking", nonblocking, false, RECEIVED_ON_BOTH },
+	{ "stream", stream, true, RECEIVED_ON_1 },
+	{ "bistream", bistream, true, RECEIVED_ON_BOTH },
+	{ "put_fence", putFence, false, RECEIVED_ON_1 },
+	{ "put_pscw", putPscw, false, RECEIVED_ON_1 },
+	{ "put_lock", putLock, false, RECEIVED_ON_1 },
+	{ "get_fence", getFence, false, RECEIVED_ON_0 },
+	{ "get_pscw", getPscw, false, RECEIVED_ON_0 },
+	{ "get_lock", getLock, false, RECEIVED_ON_0 },
+	{ "accumulate_fence", accumulateFence, false, RECEIVED_ON_1 },
+	{ "accumulate_pscw", accumulatePscw, false, RECEIVED_ON_1 },
+	{ "accumulate_lock", accumulateLock, false, RECEIVED_ON_1 },
+};
+const int MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+
+// what rank 0 reports for one version at one size, times in seconds
+struct SweepResult
+{
+	const char* mode;
+	long long bytes;
+	int window;
+	int iterations;
+	long long errors;
+	double minimum;
+	double median;
+	double p99;
+	double maximum;
+};
+
+// what rank 0 reports for one size of the -overlap sweep, median round trip
+// times in seconds
+struct OverlapResult
+{
+	long long bytes;
+	int iterations;
+	long long errors;
+	double communication;
+	double compute;
+	double together;
+};
+
+void printUsage();
+bool modeSelected(const char* modeList, const char* name);
+void createWindows(Message& message, int myRank, long long sendBytes, long long receiveBytes);
+void freeWindows(Message& message);
+double oneSided(int myRank, const Message& message, int operation, int synchronization);
+char* allocateBuffer(long long bytes, bool hugePages);
+void describeMessage(Message& message, long long bytes);
+void freeMessageType(Message& message);
+unsigned char patternByte(long long offset, long long bytes);
+void fillPattern(char* buffer, long long bytes);
+long long checkPattern(const char* buffer, long long bytes);
+SweepResult summarize(const char* mode, long long bytes, int window, long long errors, vector<double>& times);
+double percentile(const vector<double>& sortedTimes, double fraction);
+void writeHeader(ostream& out, bool json);
+void writeResult(ostream& out, bool json, const SweepResult& result);
+void computeKernel(long long steps);
+double secondsPerComputeStep();
+void runOverlap(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json);
+void writeOverlapHeader(ostream& out, bool json);
+void writeOverlapResult(ostream& out, bool json, const OverlapResult& result);
+int roundPartner(int rank, int round, int players);
+double pairMedian(int partner, bool leader, Message& message, long long bytes, int iterations, int warmup, vector<double>& times, long long& errors);
+void runAllPairs(int myRank, int commSize, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json, const char* matrixPrefix);
+void writeMatrix(const char* fileName, const vector<string>& hosts, const vector<double>& matrix, int commSize);
+void runOneWay(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json);
+
+// blocks blocks of blockBytes bytes, stride bytes apart, in sendLayout and
+// receiveLayout, as a vector and as a subarray type, and the MPI_Pack_size
+// of the vector
+struct StridedLayout
+{
+	char* sendLayout;
+	char* receiveLayout;
+	int blocks;
+	int blockBytes;
+	long long stride;
+	MPI_Datatype vectorType;
+	MPI_Datatype subarrayType;
+	int packedBytes;
+};
+
+// one way of sending a strided layout: a round trip between ranks 0 and 1,
+// returns the one-way time in seconds on rank 0
+typedef double (*LayoutMethod)(int myRank, const Message& message, const StridedLayout& layout);
+
+double sendVector(int myRank, const Message& message, const StridedLayout& layout);
+double sendSubarray(int myRank, const Message& message, const StridedLayout& layout);
+double sendPacked(int myRank, const Message& message, const StridedLayout& layout);
+double sendManual(int myRank, const Message& message, const StridedLayout& layout);
+double sendContiguous(int myRank, const Message& message, const StridedLayout& layout);
+
+// strided methods end up in the receive layout, the contiguous one in the
+// receive buffer
+struct LayoutMethodEntry
+{
+	const char* name;
+	LayoutMethod run;
+	bool strided;
+};
+
+const LayoutMethodEntry LAYOUT_METHODS[] = {
+	{ "vector", sendVector, true },
+	{ "subarray", sendSubarray, true },
+	{ "pack", sendPacked, true },
+	{ "manual", sendManual, true },
+	{ "contiguous", sendContiguous, false },
+};
+const int LAYOUT_METHOD_COUNT = sizeof(LAYOUT_METHODS) / sizeof(LAYOUT_METHODS[0]);
 
-const int MAX_STRING = 4000000;
+double stridedRoundTrip(int myRank, const StridedLayout& layout, MPI_Datatype type);
+void packLayout(const StridedLayout& layout, const char* strided, char* packed);
+void unpackLayout(const StridedLayout& layout, const char* packed, char* strided);
+void fillStrided(const StridedLayout& layout, char* strided, long long bytes);
+long long checkStrided(const StridedLayout& layout, const char* strided, long long bytes);
+void runNoncontiguous(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json, int blockBytes, const char* strideList, bool hugePages);
+
+const long long MAX_STRING = 4000000;
 const int ITERATIONS = 5000;
+const int WARMUP = 100;
+
+const int WINDOW = 64;
 
-int main()
+// the one-sided operations and synchronizations
+const int RMA_PUT = 0;
+const int RMA_GET = 1;
+const int RMA_ACCUMULATE = 2;
+const int SYNC_FENCE = 0;
+const int SYNC_PSCW = 1;
+const int SYNC_LOCK = 2;
+
+// the receive buffer is at least big enough for one of the largest messages,
+// and up to this big for the streaming windows
+const long long STREAM_BUFFER = 256LL << 20;
+
+// messages longer than this go out as 1 GB pieces
+const long long MAX_COUNT = INT_MAX;
+const long long LARGE_PIECE = 1LL << 30;
+
+const long long HUGE_PAGE = 2LL << 20;
+
+// the -noncontiguous defaults, and the most memory a strided buffer gets
+const int BLOCK_BYTES = 1;
+const char* const STRIDES = "16,256,4096";
+const long long STRIDED_BUFFER = 256LL << 20;
+
+// request and reply exchanges per rank every time the clocks are synced
+const int CLOCK_SAMPLES = 20;
+
+// steps of the compute kernel timed to find out how long one step takes
+const long long CALIBRATION_STEPS = 10000000;
+
+int main(int argc, char *argv[])
 {
 	int commSize;
 	int myRank;
 
-	int currentMessageSize = 64;
+	long long minimumSize = 1;
+	long long maximumSize = MAX_STRING;
+	int iterations = ITERATIONS;
+	int warmup = WARMUP;
+	int window = WINDOW;
+	bool json = false;
+	const char* outputFile = NULL;
+	bool hugePages = false;
+	bool overlap = false;
+	bool allPairs = false;
+	bool oneWay = false;
+	bool noncontiguous = false;
+	int blockBytes = BLOCK_BYTES;
+	const char* strideList = STRIDES;
+	const char* matrixPrefix = NULL;
+	const char* modeList = NULL;
 
-	char message[MAX_STRING];
-/*
-	for (int i = 0; i < MAX_STRING  - 1; i++)
+	for (int argument = 1; argument < argc; argument++)
+	{
+		if (strcmp(argv[argument], "-sizes") == 0 && argument + 2 < argc)
+		{
+			minimumSize = atoll(argv[argument + 1]);
+			maximumSize = atoll(argv[argument + 2]);
+			argument += 2;
+		}
+		else if (strcmp(argv[argument], "-iterations") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			iterations = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-warmup") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			warmup = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-window") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			window = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-format") == 0 && argument + 1 < argc
+			&& (strcmp(argv[argument + 1], "csv") == 0 || strcmp(argv[argument + 1], "json") == 0))
+		{
+			argument++;
+			json = strcmp(argv[argument], "json") == 0;
+		}
+		else if (strcmp(argv[argument], "-output") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			outputFile = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-hugePages") == 0)
+		{
+			hugePages = true;
+		}
+		else if (strcmp(argv[argument], "-overlap") == 0)
+		{
+			overlap = true;
+		}
+		else if (strcmp(argv[argument], "-allPairs") == 0)
+		{
+			allPairs = true;
+		}
+		else if (strcmp(argv[argument], "-oneWay") == 0)
+		{
+			oneWay = true;
+		}
+		else if (strcmp(argv[argument], "-noncontiguous") == 0)
+		{
+			noncontiguous = true;
+		}
+		else if (strcmp(argv[argument], "-block") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			blockBytes = atoi(argv[argument]);
+		}
+		else if (strcmp(argv[argument], "-strides") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			strideList = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-modes") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			modeList = argv[argument];
+		}
+		else if (strcmp(argv[argument], "-matrix") == 0 && argument + 1 < argc)
+		{
+			argument++;
+			matrixPrefix = argv[argument];
+		}
+		else
+		{
+			printUsage();
+			exit(1);
+		}
+	}
+
+	if (minimumSize < 1 || minimumSize > maximumSize || iterations < 1 || warmup < 0 || window < 1 || blockBytes < 1)
 	{
-		message[i] = 'B';
+		printUsage();
+		exit(1);
 	}
-*/
 
+	// every name in -modes has to be a version
+	if (modeList != NULL)
+	{
+		int selected = 0;
+		for (int mode = 0; mode < MODE_COUNT; mode++)
+		{
+			selected += modeSelected(modeList, MODES[mode].name) ? 1 : 0;
+		}
+		if (selected != 1 + (int)count(modeList, modeList + strlen(modeList), ','))
+		{
+			printUsage();
+			exit(1);
+		}
+	}
 
 	MPI_Init(NULL, NULL);
 	MPI_Comm_size(MPI_COMM_WORLD, &commSize);
 	MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
 
-	//while (currentMessageSize < MAX_STRING)
-	//{
-		for (int k = 0; k < currentMessageSize; k++)
+	if (commSize < 2)
+	{
+		if (myRank == 0)
 		{
-			message[k] = 'B';	
+			cout << "The ping pong needs at least 2 processes" << endl;
 		}
-		MPI_Barrier(MPI_COMM_WORLD);
-		//cout << "Normal at " << currentMessageSize << " bytes" << endl;
-		//for (int i = 0; i < ITERATIONS; i++)
-		//{	
-			regular(myRank, message, currentMessageSize);
-		//}
-		MPI_Barrier(MPI_COMM_WORLD);
-		//cout << "SendRecv at " << currentMessageSize << " bytes" << endl;
-		//for (int i = 0; i < ITERATIONS; i++)
-		//{
-			sendrecv(myRank, message, currentMessageSize);
-		//}	
-		MPI_Barrier(MPI_COMM_WORLD);
-		//cout << "Nonblocking at " << currentMessageSize << " bytes" << endl;
-		//for (int i = 0; i < ITERATIONS; i++)
-		//{
-			nonblocking(myRank, message, currentMessageSize);
-		//}
+		MPI_Finalize();
+		exit(1);
+	}
+
+	ofstream outputStream;
+	if (myRank == 0 && outputFile != NULL)
+	{
+		outputStream.open(outputFile);
+	}
+	ostream& out = (outputFile != NULL) ? outputStream : cout;
+
+	// both buffers once, for the largest message, and every page already there
+	long long receiveBytes = max(maximumSize, min(maximumSize * window, STREAM_BUFFER));
+
+	Message message;
+	message.sendBuffer = allocateBuffer(maximumSize, hugePages);
+	message.receiveBuffer = allocateBuffer(receiveBytes, hugePages);
+	message.window = 1;
+
+	if (message.sendBuffer == NULL || message.receiveBuffer == NULL)
+	{
+		cout << "Rank " << myRank << " could not allocate buffers of " << maximumSize << " and " << receiveBytes << " bytes" << endl;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	if (overlap || allPairs || oneWay || noncontiguous)
+	{
+		if (overlap)
+		{
+			runOverlap(myRank, message, minimumSize, maximumSize, iterations, warmup, out, json);
+		}
+		else if (noncontiguous)
+		{
+			runNoncontiguous(myRank, message, minimumSize, maximumSize, iterations, warmup, out, json, blockBytes, strideList, hugePages);
+		}
+		else if (oneWay)
+		{
+			runOneWay(myRank, message, minimumSize, maximumSize, iterations, warmup, out, json);
+		}
+		else
+		{
+			runAllPairs(myRank, commSize, message, minimumSize, maximumSize, iterations, warmup, out, json, matrixPrefix);
+		}
+
+		free(message.sendBuffer);
+		free(message.receiveBuffer);
+
+		MPI_Finalize();
+		return 0;
+	}
+
+	createWindows(message, myRank, maximumSize, receiveBytes);
+
+	if (myRank == 0)
+	{
+		writeHeader(out, json);
+	}
+
+	vector<double> times(iterations);
+
+	for (int mode = 0; mode < MODE_COUNT; mode++)
+	{
+		if (modeList != NULL && !modeSelected(modeList, MODES[mode].name))
+		{
+			continue;
+		}
+
+		for (long long currentMessageSize = minimumSize; currentMessageSize <= maximumSize; currentMessageSize *= 2)
+		{
+			describeMessage(message, currentMessageSize);
+			message.window = MODES[mode].windowed ? (int)min((long long)window, receiveBytes / currentMessageSize) : 1;
+			fillPattern(message.sendBuffer, currentMessageSize);
+			memset(message.receiveBuffer, 0, currentMessageSize * message.window);
+			MPI_Barrier(MPI_COMM_WORLD);
+
+			for (int i = 0; i < warmup; i++)
+			{
+				MODES[mode].run(myRank, message);
+			}
+
+			for (int i = 0; i < iterations; i++)
+			{
+				times[i] = MODES[mode].run(myRank, message);
+			}
+
+			// every message that arrived, on whichever rank it arrived
+			long long errors = 0;
+			if (myRank < 2 && (MODES[mode].receivers & (1 << myRank)) != 0)
+			{
+				for (int slot = 0; slot < message.window; slot++)
+				{
+					errors += checkPattern(message.receiveBuffer + slot * currentMessageSize, currentMessageSize);
+				}
+			}
+			long long totalErrors;
+			MPI_Reduce(&errors, &totalErrors, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+			if (myRank == 0)
+			{
+				writeResult(out, json, summarize(MODES[mode].name, currentMessageSize, message.window, totalErrors, times));
+			}
+
+			freeMessageType(message);
+		}
+	}
+
+	freeWindows(message);
+	free(message.sendBuffer);
+	free(message.receiveBuffer);
 
-//		currentMessageSize *= 2;
+	MPI_Finalize();
+}
+
+void printUsage()
+{
+	cout << "Usage: mpiexec -n <number of processes> ./ping_pong [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  -sizes <min> <max>    message sizes in bytes, doubling from min up to max (default 1 " << MAX_STRING << ")" << endl;
+	cout << "  -iterations <n>       timed round trips at every size (default " << ITERATIONS << ")" << endl;
+	cout << "  -warmup <n>           round trips before the timed ones that don't count (default " << WARMUP << ")" << endl;
+	cout << "  -modes <a,b,...>      only these versions: normal, sendrecv, nonblocking, stream, bistream," << endl;
+	cout << "                        and put, get or accumulate with _fence, _pscw or _lock (default all)" << endl;
+	cout << "  -window <n>           messages in flight at once in the streaming versions (default " << WINDOW << ")" << endl;
+	cout << "  -format csv|json      one CSV row or one JSON object per line for every version and size (default csv)" << endl;
+	cout << "  -output <file>        write the results to a file instead of the screen" << endl;
+	cout << "  -hugePages            align the buffers to 2 MB and ask for transparent huge pages" << endl;
+	cout << "  -overlap              measure how much of a nonblocking round trip hides behind computing instead" << endl;
+	cout << "  -allPairs             measure the latency (smallest size) and bandwidth (largest size) between every pair of ranks instead" << endl;
+	cout << "  -oneWay               sync the clocks and time each way of a round trip on its own instead" << endl;
+	cout << "  -noncontiguous        compare ways of sending a strided layout instead" << endl;
+	cout << "  -block <bytes>        with -noncontiguous, bytes in a row of the layout (default " << BLOCK_BYTES << ")" << endl;
+	cout << "  -strides <a,b,...>    with -noncontiguous, bytes from one row to the next (default " << STRIDES << ")" << endl;
+	cout << "  -matrix <prefix>      with -allPairs, also write <prefix>_latency.txt and <prefix>_bandwidth.txt as P x P matrices" << endl;
+}
+
+// whether name is one of the comma separated names in modeList
+bool modeSelected(const char* modeList, const char* name)
+{
+	size_t length = strlen(name);
+	for (const char* entry = modeList; entry != NULL; entry = strchr(entry, ','))
+	{
+		if (*entry == ',')
+		{
+			entry++;
+		}
+		if (strncmp(entry, name, length) == 0 && (entry[length] == ',' || entry[length] == '\0'))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+	Collective over MPI_COMM_WORLD.  Ranks 0 and 1 get a communicator of
+	their own and a window on each buffer, everybody else gets
+	MPI_COMM_NULL and no windows.
+*/
+void createWindows(Message& message, int myRank, long long sendBytes, long long receiveBytes)
+{
+	MPI_Comm_split(MPI_COMM_WORLD, (myRank < 2) ? 0 : MPI_UNDEFINED, myRank, &message.pairComm);
+
+	if (message.pairComm == MPI_COMM_NULL)
+	{
+		return;
+	}
+
+	MPI_Win_create(message.sendBuffer, sendBytes, 1, MPI_INFO_NULL, message.pairComm, &message.sendWindow);
+	MPI_Win_create(message.receiveBuffer, receiveBytes, 1, MPI_INFO_NULL, message.pairComm, &message.receiveWindow);
+
+	MPI_Group pairGroup;
+	MPI_Comm_group(message.pairComm, &pairGroup);
+	int partner = 1 - myRank;
+	MPI_Group_incl(pairGroup, 1, &partner, &message.partnerGroup);
+	MPI_Group_free(&pairGroup);
+}
+
+void freeWindows(Message& message)
+{
+	if (message.pairComm == MPI_COMM_NULL)
+	{
+		return;
+	}
+
+	MPI_Group_free(&message.partnerGroup);
+	MPI_Win_free(&message.sendWindow);
+	MPI_Win_free(&message.receiveWindow);
+	MPI_Comm_free(&message.pairComm);
+}
+
+/*
+	A buffer of bytes bytes aligned to a page, or to a huge page, with every
+	page written once so the timed loops never fault one in.  NULL if there
+	isn't that much memory.
+*/
+char* allocateBuffer(long long bytes, bool hugePages)
+{
+	long long alignment = hugePages ? HUGE_PAGE : sysconf(_SC_PAGESIZE);
+
+	// a whole number of pages, so the last huge page can be a huge page too
+	long long allocated = (bytes + alignment - 1) / alignment * alignment;
+
+	void* buffer;
+	if (posix_memalign(&buffer, alignment, allocated) != 0)
+	{
+		return NULL;
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (hugePages)
+	{
+		madvise(buffer, allocated, MADV_HUGEPAGE);
+	}
+#endif
+
+	memset(buffer, 0, allocated);
+
+	return (char*)buffer;
+}
+
+/*
+	Picks the count and datatype the message goes out as.  Up to MAX_COUNT
+	bytes it is that many MPI_UNSIGNED_CHARs, past that it is one element of
+	a struct of whole LARGE_PIECEs and the bytes left over, since the MPI
+	here has no MPI_Send_c.  Unsigned chars rather than MPI_BYTE so that
+	MPI_Accumulate can do arithmetic on them.
+*/
+void describeMessage(Message& message, long long bytes)
+{
+	message.bytes = bytes;
+
+	if (bytes <= MAX_COUNT)
+	{
+		message.type = MPI_UNSIGNED_CHAR;
+		message.count = bytes;
+		return;
+	}
+
+	MPI_Datatype piece;
+	MPI_Type_contiguous(LARGE_PIECE, MPI_UNSIGNED_CHAR, &piece);
+
+	int blockLengths[2] = { (int)(bytes / LARGE_PIECE), (int)(bytes % LARGE_PIECE) };
+	MPI_Aint displacements[2] = { 0, (MPI_Aint)(bytes / LARGE_PIECE * LARGE_PIECE) };
+	MPI_Datatype types[2] = { piece, MPI_UNSIGNED_CHAR };
+
+	MPI_Type_create_struct(2, blockLengths, displacements, types, &message.type);
+	MPI_Type_commit(&message.type);
+	MPI_Type_free(&piece);
+
+	message.count = 1;
+}
+
+void freeMessageType(Message& message)
+{
+	if (message.type != MPI_UNSIGNED_CHAR)
+	{
+		MPI_Type_free(&message.type);
+	}
+}
+
+/*
+	The byte at offset of a message of bytes bytes.  It changes along the
+	message and with the size, so a piece that got lost, moved, or is left
+	over from the last size shows up.
+*/
+unsigned char patternByte(long long offset, long long bytes)
+{
+	return (unsigned char)((offset * 131 + bytes * 7 + (offset >> 8)) & 0xFF);
+}
+
+void fillPattern(char* buffer, long long bytes)
+{
+	for (long long offset = 0; offset < bytes; offset++)
+	{
+		buffer[offset] = patternByte(offset, bytes);
+	}
+}
+
+// how many bytes of the buffer aren't the pattern
+long long checkPattern(const char* buffer, long long bytes)
+{
+	long long wrong = 0;
+	for (long long offset = 0; offset < bytes; offset++)
+	{
+		if ((unsigned char)buffer[offset] != patternByte(offset, bytes))
+		{
+			wrong++;
+		}
+	}
+	return wrong;
+}
+
+/*
+	Sorts the times of one version at one size and picks out the numbers that
+	get reported.  errors is how many bytes of the last messages that came
+	in were not the pattern.
+*/
+SweepResult summarize(const char* mode, long long bytes, int window, long long errors, vector<double>& times)
+{
+	SweepResult result;
+	result.mode = mode;
+	result.bytes = bytes;
+	result.window = window;
+
+	sort(times.begin(), times.end());
+
+	result.iterations = times.size();
+	result.errors = errors;
+	result.minimum = percentile(times, 0);
+	result.median = percentile(times, 0.5);
+	result.p99 = percentile(times, 0.99);
+	result.maximum = percentile(times, 1);
+
+	return result;
+}
+
+/*
+	Nearest rank percentile: the smallest time that at least fraction of the
+	times are less than or equal to.
+*/
+double percentile(const vector<double>& sortedTimes, double fraction)
+{
+	if (sortedTimes.empty())
+	{
+		return 0;
+	}
+
+	int rank = (int)ceil(fraction * sortedTimes.size()) - 1;
+	return sortedTimes[max(0, min(rank, (int)sortedTimes.size() - 1))];
+}
+
+void writeHeader(ostream& out, bool json)
+{
+	if (!json)
+	{
+		out << "mode,bytes,window,iterations,wrong_bytes,min_us,median_us,p99_us,max_us,bandwidth_MBps,messages_per_s" << endl;
+	}
+}
+
+/*
+	Latencies go out in microseconds, the bandwidth is the message size over
+	the median one-way time in MB/s (10^6 bytes), and the message rate is one
+	over the median.
+*/
+void writeResult(ostream& out, bool json, const SweepResult& result)
+{
+	double bandwidth = (result.median > 0) ? result.bytes / result.median / 1e6 : 0;
+	double messageRate = (result.median > 0) ? 1 / result.median : 0;
 
-	//}
-	
-	MPI_Finalize();	
+	out << fixed << setprecision(3);
+	if (json)
+	{
+		out << "{\"mode\": \"" << result.mode << "\", \"bytes\": " << result.bytes << ", \"window\": " << result.window << ", \"iterations\": " << result.iterations
+			<< ", \"wrong_bytes\": " << result.errors << ", \"min_us\": " << result.minimum * 1e6 << ", \"median_us\": " << result.median * 1e6
+			<< ", \"p99_us\": " << result.p99 * 1e6 << ", \"max_us\": " << result.maximum * 1e6 << ", \"bandwidth_MBps\": " << bandwidth
+			<< ", \"messages_per_s\": " << messageRate << "}" << endl;
+	}
+	else
+	{
+		out << result.mode << "," << result.bytes << "," << result.window << "," << result.iterations << "," << result.errors << "," << result.minimum * 1e6 << ","
+			<< result.median * 1e6 << "," << result.p99 * 1e6 << "," << result.maximum * 1e6 << "," << bandwidth << "," << messageRate << endl;
+	}
 }
 
 /*
 	Blocking Implementation
 */
-void regular(int myRank, char* myMessage, int currentSize)
+double regular(int myRank, const Message& message)
 {
 	double startTime, endTime;
-	char newMessage[MAX_STRING];
 	if (myRank == 0)
 	{
 		startTime = MPI_Wtime();
-		MPI_Ssend(myMessage, currentSize, MPI_CHAR, 1, 0, MPI_COMM_WORLD);
-		MPI_Recv(newMessage, currentSize, MPI_CHAR, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Ssend(message.sendBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 		endTime = MPI_Wtime();
 
-		if (strcmp(newMessage, myMessage) == 0)
-		{
-			cout << "Normal at " << currentSize << " bytes" << endl;
-			cout << ((endTime - startTime) / 2) * 1000 << endl;//" ms" << endl;
-		}
+		return (endTime - startTime) / 2;
 	}
 	else if (myRank == 1)
 	{
-		MPI_Recv(myMessage, currentSize, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		MPI_Send(myMessage, currentSize, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Send(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD);
 	}
+	return 0;
 }
 /*
 	SendRecv Implementation
 */
-void sendrecv(int myRank, char* myMessage, int currentSize)
+double sendrecv(int myRank, const Message& message)
 {
-	char myNewMessage[MAX_STRING];
 	double startTime, endTime;
 
 	if (myRank == 0)
 	{
 		startTime = MPI_Wtime();
-		MPI_Sendrecv(myMessage, currentSize, MPI_CHAR, 1, 0, myNewMessage, currentSize, MPI_CHAR, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE); 	
+		MPI_Sendrecv(message.sendBuffer, message.count, message.type, 1, 0, message.receiveBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 		endTime = MPI_Wtime();
-		if (strcmp(myNewMessage, myMessage) == 0)
-		{
-			cout << "SendRecv at " << currentSize << " bytes" << endl;
-			cout << ((endTime - startTime) / 2) * 1000 << endl;//" ms" << endl;
-		}
+
+		return (endTime - startTime) / 2;
 	}
 	else if (myRank == 1)
 	{
-		MPI_Sendrecv(myMessage, currentSize, MPI_CHAR, 0, 0, myNewMessage, currentSize, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Sendrecv(message.sendBuffer, message.count, message.type, 0, 0, message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 	}
+	return 0;
 }
 
 /*
 	Nonblocking Implementation
 */
-void nonblocking(int myRank, char* myMessage, int currentSize)
+double nonblocking(int myRank, const Message& message)
+{
+	return overlapped(myRank, message, 0) / 2;
+}
+
+double overlapped(int myRank, const Message& message, long long computeSteps)
 {
 	double startTime, endTime;
-	char myNewMessage[MAX_STRING];
 
 	MPI_Request requests[2];
 
 	if (myRank == 0)
 	{
+		// the receive is posted first so the echo never has to wait for it
 		startTime = MPI_Wtime();
-		MPI_Isend(myMessage, currentSize, MPI_CHAR, 1, 0, MPI_COMM_WORLD, &requests[0]);
-		MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
-		MPI_Irecv(myNewMessage, currentSize, MPI_CHAR, 1, 0, MPI_COMM_WORLD, &requests[1]);
+		MPI_Irecv(message.receiveBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, &requests[0]);
+		MPI_Isend(message.sendBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, &requests[1]);
+		computeKernel(computeSteps);
+		MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
 		endTime = MPI_Wtime();
-		if (strcmp(myNewMessage, myMessage) == 0)
-		{
-			cout << "Non Blocking at " << currentSize << " bytes" << endl;
-			cout << ((endTime - startTime) / 2) * 1000 << endl; //" ms" << endl;
-		}
+
+		return endTime - startTime;
 	}
 	else if (myRank == 1)
 	{
-		MPI_Irecv(myMessage, currentSize, MPI_CHAR, 0, 0, MPI_COMM_WORLD, &requests[0]);
+		MPI_Irecv(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD, &requests[0]);
 		MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
-		MPI_Isend(myMessage, currentSize, MPI_CHAR, 0, 0, MPI_COMM_WORLD, &requests[1]);
+		MPI_Isend(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD, &requests[1]);
+		MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
 	}
+	return 0;
+}
+
+/*
+	Streaming Implementation
+*/
+double stream(int myRank, const Message& message)
+{
+	double startTime, endTime;
+
+	vector<MPI_Request> requests(message.window);
+
+	if (myRank == 0)
+	{
+		startTime = MPI_Wtime();
+		for (int slot = 0; slot < message.window; slot++)
+		{
+			MPI_Isend(message.sendBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, &requests[slot]);
+		}
+		MPI_Waitall(message.window, &requests[0], MPI_STATUSES_IGNORE);
+		MPI_Recv(NULL, 0, MPI_BYTE, 1, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / message.window;
+	}
+	else if (myRank == 1)
+	{
+		for (int slot = 0; slot < message.window; slot++)
+		{
+			MPI_Irecv(message.receiveBuffer + slot * message.bytes, message.count, message.type, 0, 0, MPI_COMM_WORLD, &requests[slot]);
+		}
+		MPI_Waitall(message.window, &requests[0], MPI_STATUSES_IGNORE);
+		MPI_Send(NULL, 0, MPI_BYTE, 0, 1, MPI_COMM_WORLD);
+	}
+	return 0;
+}
+
+/*
+	Bidirectional Streaming Implementation
+*/
+double bistream(int myRank, const Message& message)
+{
+	double startTime, endTime;
+
+	if (myRank > 1)
+	{
+		return 0;
+	}
+
+	int otherRank = 1 - myRank;
+	vector<MPI_Request> requests(2 * message.window);
+
+	startTime = MPI_Wtime();
+	for (int slot = 0; slot < message.window; slot++)
+	{
+		MPI_Irecv(message.receiveBuffer + slot * message.bytes, message.count, message.type, otherRank, 0, MPI_COMM_WORLD, &requests[slot]);
+	}
+	for (int slot = 0; slot < message.window; slot++)
+	{
+		MPI_Isend(message.sendBuffer, message.count, message.type, otherRank, 0, MPI_COMM_WORLD, &requests[message.window + slot]);
+	}
+	MPI_Waitall(2 * message.window, &requests[0], MPI_STATUSES_IGNORE);
+	endTime = MPI_Wtime();
+
+	return (myRank == 0) ? (endTime - startTime) / (2 * message.window) : 0;
+}
+
+/*
+	One-Sided Implementation
+*/
+double oneSided(int myRank, const Message& message, int operation, int synchronization)
+{
+	double startTime, endTime;
+
+	if (myRank > 1)
+	{
+		return 0;
+	}
+
+	// gets read rank 1's send buffer, puts and accumulates write its receive buffer
+	MPI_Win window = (operation == RMA_GET) ? message.sendWindow : message.receiveWindow;
+
+	if (myRank == 1)
+	{
+		if (synchronization == SYNC_FENCE)
+		{
+			MPI_Win_fence(0, window);
+			MPI_Win_fence(0, window);
+		}
+		else if (synchronization == SYNC_PSCW)
+		{
+			MPI_Win_post(message.partnerGroup, 0, window);
+			MPI_Win_wait(window);
+		}
+		else
+		{
+			// rank 0 is done with my window when it gets here
+			MPI_Barrier(message.pairComm);
+		}
+		return 0;
+	}
+
+	if (synchronization == SYNC_FENCE)
+	{
+		MPI_Win_fence(0, window);
+	}
+	else if (synchronization == SYNC_LOCK)
+	{
+		MPI_Win_lock(MPI_LOCK_SHARED, 1, 0, window);
+	}
+
+	startTime = MPI_Wtime();
+	if (synchronization == SYNC_PSCW)
+	{
+		MPI_Win_start(message.partnerGroup, 0, window);
+	}
+
+	if (operation == RMA_PUT)
+	{
+		MPI_Put(message.sendBuffer, message.count, message.type, 1, 0, message.count, message.type, window);
+	}
+	else if (operation == RMA_GET)
+	{
+		MPI_Get(message.receiveBuffer, message.count, message.type, 1, 0, message.count, message.type, window);
+	}
+	else
+	{
+		MPI_Accumulate(message.sendBuffer, message.count, message.type, 1, 0, message.count, message.type, MPI_BOR, window);
+	}
+
+	if (synchronization == SYNC_FENCE)
+	{
+		MPI_Win_fence(0, window);
+	}
+	else if (synchronization == SYNC_PSCW)
+	{
+		MPI_Win_complete(window);
+	}
+	else
+	{
+		MPI_Win_flush(1, window);
+	}
+	endTime = MPI_Wtime();
+
+	if (synchronization == SYNC_LOCK)
+	{
+		MPI_Win_unlock(1, window);
+		MPI_Barrier(message.pairComm);
+	}
+
+	return endTime - startTime;
+}
+
+double putFence(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_PUT, SYNC_FENCE);
+}
+
+double putPscw(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_PUT, SYNC_PSCW);
+}
+
+double putLock(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_PUT, SYNC_LOCK);
+}
+
+double getFence(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_GET, SYNC_FENCE);
+}
+
+double getPscw(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_GET, SYNC_PSCW);
+}
+
+double getLock(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_GET, SYNC_LOCK);
+}
+
+double accumulateFence(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_ACCUMULATE, SYNC_FENCE);
+}
+
+double accumulatePscw(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_ACCUMULATE, SYNC_PSCW);
+}
+
+double accumulateLock(int myRank, const Message& message)
+{
+	return oneSided(myRank, message, RMA_ACCUMULATE, SYNC_LOCK);
+}
+
+// where the kernel leaves its result, so the compiler can't drop the loop
+volatile double computeResult = 0;
+
+/*
+	The made up computation: a chain of multiply-adds where every step needs
+	the one before, so it takes the same time at every optimization level and
+	doesn't touch memory that the messages are using.
+*/
+void computeKernel(long long steps)
+{
+	double value = computeResult;
+	for (long long step = 0; step < steps; step++)
+	{
+		value = value * 0.999999 + 0.000001;
+	}
+	computeResult = value;
+}
+
+double secondsPerComputeStep()
+{
+	double startTime = MPI_Wtime();
+	computeKernel(CALIBRATION_STEPS);
+	return (MPI_Wtime() - startTime) / CALIBRATION_STEPS;
+}
+
+/*
+	The -overlap sweep.  Only rank 0 computes, rank 1 just echoes, so at every
+	size both ranks go through the same round trips: the ones without
+	computing and then the ones with it.  Rank 0 times the kernel on its own
+	in between.
+*/
+void runOverlap(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json)
+{
+	double stepTime = 0;
+	if (myRank == 0)
+	{
+		stepTime = secondsPerComputeStep();
+		writeOverlapHeader(out, json);
+	}
+
+	vector<double> communicationTimes(iterations);
+	vector<double> computeTimes(iterations);
+	vector<double> togetherTimes(iterations);
+
+	for (long long currentMessageSize = minimumSize; currentMessageSize <= maximumSize; currentMessageSize *= 2)
+	{
+		describeMessage(message, currentMessageSize);
+		fillPattern(message.sendBuffer, currentMessageSize);
+		memset(message.receiveBuffer, 0, currentMessageSize);
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		for (int i = 0; i < warmup; i++)
+		{
+			overlapped(myRank, message, 0);
+		}
+		for (int i = 0; i < iterations; i++)
+		{
+			communicationTimes[i] = overlapped(myRank, message, 0);
+		}
+
+		// enough computing to take as long as the median round trip
+		long long computeSteps = 0;
+		if (myRank == 0)
+		{
+			sort(communicationTimes.begin(), communicationTimes.end());
+			computeSteps = max(1LL, (long long)(percentile(communicationTimes, 0.5) / stepTime));
+
+			for (int i = 0; i < iterations; i++)
+			{
+				double startTime = MPI_Wtime();
+				computeKernel(computeSteps);
+				computeTimes[i] = MPI_Wtime() - startTime;
+			}
+		}
+
+		for (int i = 0; i < iterations; i++)
+		{
+			togetherTimes[i] = overlapped(myRank, message, computeSteps);
+		}
+
+		if (myRank == 0)
+		{
+			sort(computeTimes.begin(), computeTimes.end());
+			sort(togetherTimes.begin(), togetherTimes.end());
+
+			OverlapResult result;
+			result.bytes = currentMessageSize;
+			result.iterations = iterations;
+			result.errors = checkPattern(message.receiveBuffer, currentMessageSize);
+			result.communication = percentile(communicationTimes, 0.5);
+			result.compute = percentile(computeTimes, 0.5);
+			result.together = percentile(togetherTimes, 0.5);
+			writeOverlapResult(out, json, result);
+		}
+
+		freeMessageType(message);
+	}
+}
+
+void writeOverlapHeader(ostream& out, bool json)
+{
+	if (!json)
+	{
+		out << "bytes,iterations,wrong_bytes,communication_us,compute_us,together_us,overlap_percent" << endl;
+	}
+}
+
+/*
+	Round trip times in microseconds.  The overlap can come out a little
+	below 0 or above 100 from noise, it is left that way rather than
+	clamped.
+*/
+void writeOverlapResult(ostream& out, bool json, const OverlapResult& result)
+{
+	double hidden = result.communication + result.compute - result.together;
+	double shorter = min(result.communication, result.compute);
+	double percent = (shorter > 0) ? 100 * hidden / shorter : 0;
+
+	out << fixed << setprecision(3);
+	if (json)
+	{
+		out << "{\"bytes\": " << result.bytes << ", \"iterations\": " << result.iterations << ", \"wrong_bytes\": " << result.errors
+			<< ", \"communication_us\": " << result.communication * 1e6 << ", \"compute_us\": " << result.compute * 1e6
+			<< ", \"together_us\": " << result.together * 1e6 << ", \"overlap_percent\": " << percent << "}" << endl;
+	}
+	else
+	{
+		out << result.bytes << "," << result.iterations << "," << result.errors << "," << result.communication * 1e6 << ","
+			<< result.compute * 1e6 << "," << result.together * 1e6 << "," << percent << endl;
+	}
+}
+
+double pairRoundTrip(int partner, bool leader, const Message& message)
+{
+	double startTime, endTime;
+
+	if (leader)
+	{
+		startTime = MPI_Wtime();
+		MPI_Ssend(message.sendBuffer, message.count, message.type, partner, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, message.count, message.type, partner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / 2;
+	}
+
+	MPI_Recv(message.receiveBuffer, message.count, message.type, partner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	MPI_Send(message.receiveBuffer, message.count, message.type, partner, 0, MPI_COMM_WORLD);
+	return 0;
+}
+
+/*
+	Who rank plays in a round of a round robin with an even number of
+	players (the circle method): the last player stays put and plays round,
+	everybody else plays the one they add up to 2 * round with, counting
+	around players - 1.
+*/
+int roundPartner(int rank, int round, int players)
+{
+	int circle = players - 1;
+
+	if (rank == circle)
+	{
+		return round;
+	}
+	if (rank == round)
+	{
+		return circle;
+	}
+	return ((2 * round - rank) % circle + circle) % circle;
+}
+
+/*
+	The median one-way time between me and partner at one size, only on the
+	leader.  errors gets the wrong bytes of the last message I received.
+*/
+double pairMedian(int partner, bool leader, Message& message, long long bytes, int iterations, int warmup, vector<double>& times, long long& errors)
+{
+	describeMessage(message, bytes);
+	fillPattern(message.sendBuffer, bytes);
+	memset(message.receiveBuffer, 0, bytes);
+
+	for (int i = 0; i < warmup; i++)
+	{
+		pairRoundTrip(partner, leader, message);
+	}
+	for (int i = 0; i < iterations; i++)
+	{
+		times[i] = pairRoundTrip(partner, leader, message);
+	}
+
+	errors += checkPattern(message.receiveBuffer, bytes);
+	freeMessageType(message);
+
+	sort(times.begin(), times.end());
+	return percentile(times, 0.5);
+}
+
+/*
+	The -allPairs sweep.  Every rank fills in the pairs it led, and adding
+	up everybody's matrices on rank 0 gives the whole thing since every pair
+	has exactly one leader.
+*/
+void runAllPairs(int myRank, int commSize, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json, const char* matrixPrefix)
+{
+	char myHost[MPI_MAX_PROCESSOR_NAME];
+	int hostLength;
+	memset(myHost, 0, sizeof(myHost));
+	MPI_Get_processor_name(myHost, &hostLength);
+
+	vector<char> allHosts(commSize * MPI_MAX_PROCESSOR_NAME);
+	MPI_Gather(myHost, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, &allHosts[0], MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+	// an odd number of ranks gets a made up one, whoever plays it sits out
+	int players = commSize + commSize % 2;
+
+	vector<double> latencies(commSize * commSize, 0);
+	vector<double> bandwidths(commSize * commSize, 0);
+	vector<double> wrongBytes(commSize * commSize, 0);
+	vector<double> times(iterations);
+
+	for (int round = 0; round < players - 1; round++)
+	{
+		int partner = roundPartner(myRank, round, players);
+
+		// everybody starts the round together, so a slow pair from the last
+		// round doesn't run into this one
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		if (partner >= commSize)
+		{
+			continue;
+		}
+
+		bool leader = myRank < partner;
+		long long errors = 0;
+		double latency = pairMedian(partner, leader, message, minimumSize, iterations, warmup, times, errors);
+		double bandwidthTime = pairMedian(partner, leader, message, maximumSize, iterations, warmup, times, errors);
+
+		// the partner's wrong bytes go on its own entry, they get added up below
+		wrongBytes[myRank * commSize + partner] = errors;
+
+		if (leader)
+		{
+			latencies[myRank * commSize + partner] = latency;
+			latencies[partner * commSize + myRank] = latency;
+			bandwidths[myRank * commSize + partner] = (bandwidthTime > 0) ? maximumSize / bandwidthTime / 1e6 : 0;
+			bandwidths[partner * commSize + myRank] = bandwidths[myRank * commSize + partner];
+		}
+	}
+
+	vector<double> allLatencies(commSize * commSize);
+	vector<double> allBandwidths(commSize * commSize);
+	vector<double> allWrongBytes(commSize * commSize);
+	MPI_Reduce(&latencies[0], &allLatencies[0], commSize * commSize, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&bandwidths[0], &allBandwidths[0], commSize * commSize, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&wrongBytes[0], &allWrongBytes[0], commSize * commSize, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+	if (myRank != 0)
+	{
+		return;
+	}
+
+	vector<string> hosts(commSize);
+	for (int rank = 0; rank < commSize; rank++)
+	{
+		hosts[rank] = string(&allHosts[rank * MPI_MAX_PROCESSOR_NAME]);
+	}
+
+	if (!json)
+	{
+		out << "rank_a,host_a,rank_b,host_b,same_host,latency_bytes,latency_us,bandwidth_bytes,bandwidth_MBps,wrong_bytes" << endl;
+	}
+
+	out << fixed << setprecision(3);
+	for (int a = 0; a < commSize; a++)
+	{
+		for (int b = a + 1; b < commSize; b++)
+		{
+			int sameHost = (hosts[a] == hosts[b]) ? 1 : 0;
+			long long errors = (long long)(allWrongBytes[a * commSize + b] + allWrongBytes[b * commSize + a]);
+
+			if (json)
+			{
+				out << "{\"rank_a\": " << a << ", \"host_a\": \"" << hosts[a] << "\", \"rank_b\": " << b << ", \"host_b\": \"" << hosts[b]
+					<< "\", \"same_host\": " << sameHost << ", \"latency_bytes\": " << minimumSize << ", \"latency_us\": " << allLatencies[a * commSize + b] * 1e6
+					<< ", \"bandwidth_bytes\": " << maximumSize << ", \"bandwidth_MBps\": " << allBandwidths[a * commSize + b] << ", \"wrong_bytes\": " << errors << "}" << endl;
+			}
+			else
+			{
+				out << a << "," << hosts[a] << "," << b << "," << hosts[b] << "," << sameHost << "," << minimumSize << "," << allLatencies[a * commSize + b] * 1e6
+					<< "," << maximumSize << "," << allBandwidths[a * commSize + b] << "," << errors << endl;
+			}
+		}
+	}
+
+	if (matrixPrefix != NULL)
+	{
+		// latencies in microseconds like everywhere else
+		for (int entry = 0; entry < commSize * commSize; entry++)
+		{
+			allLatencies[entry] *= 1e6;
+		}
+		writeMatrix((string(matrixPrefix) + "_latency.txt").c_str(), hosts, allLatencies, commSize);
+		writeMatrix((string(matrixPrefix) + "_bandwidth.txt").c_str(), hosts, allBandwidths, commSize);
+	}
+}
+
+/*
+	A P x P matrix as P lines of P numbers, row and column i being rank i,
+	after a comment line with the hostname of every rank in the same order.
+*/
+void writeMatrix(const char* fileName, const vector<string>& hosts, const vector<double>& matrix, int commSize)
+{
+	ofstream file(fileName);
+	if (!file)
+	{
+		cout << "Could not write " << fileName << endl;
+		return;
+	}
+
+	file << "#";
+	for (int rank = 0; rank < commSize; rank++)
+	{
+		file << " " << hosts[rank];
+	}
+	file << endl;
+
+	file << fixed << setprecision(3);
+	for (int row = 0; row < commSize; row++)
+	{
+		for (int column = 0; column < commSize; column++)
+		{
+			file << (column > 0 ? " " : "") << matrix[row * commSize + column];
+		}
+		file << endl;
+	}
+}
+
+/*
+	The -oneWay sweep.  Rank 1 keeps its times until the end of a size and
+	then sends them to rank 0 with its sync error, so nothing but the round
+	trips happens while they are timed.
+*/
+void runOneWay(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json)
+{
+	ClockSync clock;
+	startClockSync(clock, MPI_COMM_WORLD, CLOCK_SAMPLES);
+
+	if (myRank == 0 && !json)
+	{
+		out << "bytes,iterations,wrong_bytes,forward_median_us,forward_p99_us,backward_median_us,backward_p99_us,half_round_trip_us,sync_error_us,drift_ppm" << endl;
+	}
+
+	vector<double> sent(iterations);
+	vector<double> returned(iterations);
+
+	// rank 1's arrival and echo times, then its sync error and drift
+	vector<double> rankOneTimes(2 * iterations + 2);
+
+	for (long long currentMessageSize = minimumSize; currentMessageSize <= maximumSize; currentMessageSize *= 2)
+	{
+		resyncClocks(clock, MPI_COMM_WORLD, CLOCK_SAMPLES);
+
+		describeMessage(message, currentMessageSize);
+		fillPattern(message.sendBuffer, currentMessageSize);
+		memset(message.receiveBuffer, 0, currentMessageSize);
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		for (int i = 0; i < warmup && myRank < 2; i++)
+		{
+			pairRoundTrip(1 - myRank, myRank == 0, message);
+		}
+
+		for (int i = 0; i < iterations && myRank < 2; i++)
+		{
+			if (myRank == 0)
+			{
+				sent[i] = globalTime(clock);
+				MPI_Send(message.sendBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD);
+				MPI_Recv(message.receiveBuffer, message.count, message.type, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				returned[i] = globalTime(clock);
+			}
+			else
+			{
+				MPI_Recv(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				rankOneTimes[2 * i] = globalTime(clock);
+				rankOneTimes[2 * i + 1] = globalTime(clock);
+				MPI_Send(message.receiveBuffer, message.count, message.type, 0, 0, MPI_COMM_WORLD);
+			}
+		}
+
+		if (myRank == 1)
+		{
+			rankOneTimes[2 * iterations] = clock.delay / 2;
+			rankOneTimes[2 * iterations + 1] = clock.drift;
+			MPI_Send(&rankOneTimes[0], 2 * iterations + 2, MPI_DOUBLE, 0, 1, MPI_COMM_WORLD);
+		}
+		else if (myRank == 0)
+		{
+			MPI_Recv(&rankOneTimes[0], 2 * iterations + 2, MPI_DOUBLE, 1, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+			vector<double> forward(iterations);
+			vector<double> backward(iterations);
+			vector<double> halfRoundTrip(iterations);
+			for (int i = 0; i < iterations; i++)
+			{
+				forward[i] = rankOneTimes[2 * i] - sent[i];
+				backward[i] = returned[i] - rankOneTimes[2 * i + 1];
+				halfRoundTrip[i] = (returned[i] - sent[i]) / 2;
+			}
+			sort(forward.begin(), forward.end());
+			sort(backward.begin(), backward.end());
+			sort(halfRoundTrip.begin(), halfRoundTrip.end());
+
+			long long errors = checkPattern(message.receiveBuffer, currentMessageSize);
+			double syncError = rankOneTimes[2 * iterations];
+			double drift = rankOneTimes[2 * iterations + 1];
+
+			out << fixed << setprecision(3);
+			if (json)
+			{
+				out << "{\"bytes\": " << currentMessageSize << ", \"iterations\": " << iterations << ", \"wrong_bytes\": " << errors
+					<< ", \"forward_median_us\": " << percentile(forward, 0.5) * 1e6 << ", \"forward_p99_us\": " << percentile(forward, 0.99) * 1e6
+					<< ", \"backward_median_us\": " << percentile(backward, 0.5) * 1e6 << ", \"backward_p99_us\": " << percentile(backward, 0.99) * 1e6
+					<< ", \"half_round_trip_us\": " << percentile(halfRoundTrip, 0.5) * 1e6 << ", \"sync_error_us\": " << syncError * 1e6
+					<< ", \"drift_ppm\": " << drift * 1e6 << "}" << endl;
+			}
+			else
+			{
+				out << currentMessageSize << "," << iterations << "," << errors << "," << percentile(forward, 0.5) * 1e6 << ","
+					<< percentile(forward, 0.99) * 1e6 << "," << percentile(backward, 0.5) * 1e6 << "," << percentile(backward, 0.99) * 1e6 << ","
+					<< percentile(halfRoundTrip, 0.5) * 1e6 << "," << syncError * 1e6 << "," << drift * 1e6 << endl;
+			}
+		}
+
+		freeMessageType(message);
+	}
+}
+
+/*
+	Derived Datatype Implementations
+*/
+double sendVector(int myRank, const Message&, const StridedLayout& layout)
+{
+	return stridedRoundTrip(myRank, layout, layout.vectorType);
+}
+
+double sendSubarray(int myRank, const Message&, const StridedLayout& layout)
+{
+	return stridedRoundTrip(myRank, layout, layout.subarrayType);
+}
+
+// one element of type goes out of my send layout and comes back into my receive layout
+double stridedRoundTrip(int myRank, const StridedLayout& layout, MPI_Datatype type)
+{
+	double startTime, endTime;
+
+	if (myRank == 0)
+	{
+		startTime = MPI_Wtime();
+		MPI_Send(layout.sendLayout, 1, type, 1, 0, MPI_COMM_WORLD);
+		MPI_Recv(layout.receiveLayout, 1, type, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / 2;
+	}
+	else if (myRank == 1)
+	{
+		MPI_Recv(layout.receiveLayout, 1, type, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Send(layout.receiveLayout, 1, type, 0, 0, MPI_COMM_WORLD);
+	}
+	return 0;
+}
+
+/*
+	MPI_Pack Implementation
+*/
+double sendPacked(int myRank, const Message& message, const StridedLayout& layout)
+{
+	double startTime, endTime;
+
+	// runNoncontiguous has made sure this fits in both buffers
+	int packedBytes = layout.packedBytes;
+
+	int position = 0;
+	if (myRank == 0)
+	{
+		startTime = MPI_Wtime();
+		MPI_Pack(layout.sendLayout, 1, layout.vectorType, message.sendBuffer, packedBytes, &position, MPI_COMM_WORLD);
+		MPI_Send(message.sendBuffer, position, MPI_PACKED, 1, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, packedBytes, MPI_PACKED, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		position = 0;
+		MPI_Unpack(message.receiveBuffer, packedBytes, &position, layout.receiveLayout, 1, layout.vectorType, MPI_COMM_WORLD);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / 2;
+	}
+	else if (myRank == 1)
+	{
+		MPI_Recv(message.receiveBuffer, packedBytes, MPI_PACKED, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Unpack(message.receiveBuffer, packedBytes, &position, layout.receiveLayout, 1, layout.vectorType, MPI_COMM_WORLD);
+		position = 0;
+		MPI_Pack(layout.receiveLayout, 1, layout.vectorType, message.sendBuffer, packedBytes, &position, MPI_COMM_WORLD);
+		MPI_Send(message.sendBuffer, position, MPI_PACKED, 0, 0, MPI_COMM_WORLD);
+	}
+	return 0;
+}
+
+/*
+	Hand Packed Implementation
+*/
+double sendManual(int myRank, const Message& message, const StridedLayout& layout)
+{
+	double startTime, endTime;
+
+	int bytes = layout.blocks * layout.blockBytes;
+
+	if (myRank == 0)
+	{
+		startTime = MPI_Wtime();
+		packLayout(layout, layout.sendLayout, message.sendBuffer);
+		MPI_Send(message.sendBuffer, bytes, MPI_UNSIGNED_CHAR, 1, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, bytes, MPI_UNSIGNED_CHAR, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		unpackLayout(layout, message.receiveBuffer, layout.receiveLayout);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / 2;
+	}
+	else if (myRank == 1)
+	{
+		MPI_Recv(message.receiveBuffer, bytes, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		unpackLayout(layout, message.receiveBuffer, layout.receiveLayout);
+		packLayout(layout, layout.receiveLayout, message.sendBuffer);
+		MPI_Send(message.sendBuffer, bytes, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD);
+	}
+	return 0;
+}
+
+/*
+	Contiguous Implementation, the same bytes without any layout
+*/
+double sendContiguous(int myRank, const Message& message, const StridedLayout& layout)
+{
+	double startTime, endTime;
+
+	int bytes = layout.blocks * layout.blockBytes;
+
+	if (myRank == 0)
+	{
+		startTime = MPI_Wtime();
+		MPI_Send(message.sendBuffer, bytes, MPI_UNSIGNED_CHAR, 1, 0, MPI_COMM_WORLD);
+		MPI_Recv(message.receiveBuffer, bytes, MPI_UNSIGNED_CHAR, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		endTime = MPI_Wtime();
+
+		return (endTime - startTime) / 2;
+	}
+	else if (myRank == 1)
+	{
+		MPI_Recv(message.receiveBuffer, bytes, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Send(message.receiveBuffer, bytes, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD);
+	}
+	return 0;
+}
+
+void packLayout(const StridedLayout& layout, const char* strided, char* packed)
+{
+	for (int block = 0; block < layout.blocks; block++)
+	{
+		memcpy(packed + (long long)block * layout.blockBytes, strided + block * layout.stride, layout.blockBytes);
+	}
+}
+
+void unpackLayout(const StridedLayout& layout, const char* packed, char* strided)
+{
+	for (int block = 0; block < layout.blocks; block++)
+	{
+		memcpy(strided + block * layout.stride, packed + (long long)block * layout.blockBytes, layout.blockBytes);
+	}
+}
+
+// the pattern of a message of bytes bytes, spread out over the layout
+void fillStrided(const StridedLayout& layout, char* strided, long long bytes)
+{
+	for (long long offset = 0; offset < bytes; offset++)
+	{
+		strided[offset / layout.blockBytes * layout.stride + offset % layout.blockBytes] = patternByte(offset, bytes);
+	}
+}
+
+long long checkStrided(const StridedLayout& layout, const char* strided, long long bytes)
+{
+	long long wrong = 0;
+	for (long long offset = 0; offset < bytes; offset++)
+	{
+		if ((unsigned char)strided[offset / layout.blockBytes * layout.stride + offset % layout.blockBytes] != patternByte(offset, bytes))
+		{
+			wrong++;
+		}
+	}
+	return wrong;
+}
+
+/*
+	The -noncontiguous sweep.  The sizes are the bytes that go over, rounded
+	down to whole blocks, and every stride gets every size whose layout
+	fits in the strided buffers.
+*/
+void runNoncontiguous(int myRank, Message& message, long long minimumSize, long long maximumSize, int iterations, int warmup, ostream& out, bool json, int blockBytes, const char* strideList, bool hugePages)
+{
+	vector<long long> strides;
+	for (const char* entry = strideList; entry != NULL; entry = strchr(entry, ','))
+	{
+		if (*entry == ',')
+		{
+			entry++;
+		}
+		// a row has to fit in a stride, and the subarray type takes the
+		// stride as an int dimension
+		long long stride = atoll(entry);
+		if (stride >= blockBytes && stride <= INT_MAX)
+		{
+			strides.push_back(stride);
+		}
+	}
+
+	// big enough for the largest layout that is kept
+	long long layoutBytes = 0;
+	for (size_t i = 0; i < strides.size(); i++)
+	{
+		long long largest = (maximumSize / blockBytes - 1) * strides[i] + blockBytes;
+		layoutBytes = max(layoutBytes, min(largest, STRIDED_BUFFER));
+	}
+
+	StridedLayout layout;
+	layout.blockBytes = blockBytes;
+	layout.sendLayout = allocateBuffer(max(layoutBytes, 1LL), hugePages);
+	layout.receiveLayout = allocateBuffer(max(layoutBytes, 1LL), hugePages);
+
+	if (layout.sendLayout == NULL || layout.receiveLayout == NULL)
+	{
+		cout << "Rank " << myRank << " could not allocate two layouts of " << layoutBytes << " bytes" << endl;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	if (myRank == 0 && !json)
+	{
+		out << "method,bytes,block_bytes,stride_bytes,iterations,wrong_bytes,min_us,median_us,p99_us,max_us,bandwidth_MBps" << endl;
+	}
+
+	vector<double> times(iterations);
+
+	for (size_t i = 0; i < strides.size(); i++)
+	{
+		layout.stride = strides[i];
+
+		for (long long currentMessageSize = minimumSize; currentMessageSize <= maximumSize; currentMessageSize *= 2)
+		{
+			long long blocks = currentMessageSize / blockBytes;
+			if (blocks < 1 || blocks > INT_MAX || (blocks - 1) * layout.stride + blockBytes > layoutBytes)
+			{
+				continue;
+			}
+
+			layout.blocks = blocks;
+			long long bytes = blocks * blockBytes;
+
+			MPI_Type_vector(layout.blocks, blockBytes, layout.stride, MPI_UNSIGNED_CHAR, &layout.vectorType);
+			MPI_Type_commit(&layout.vectorType);
+
+			// the same thing as a blocks x stride array with a blocks x blockBytes piece in it
+			int sizes[2] = { layout.blocks, (int)layout.stride };
+			int subsizes[2] = { layout.blocks, blockBytes };
+			int starts[2] = { 0, 0 };
+			MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_UNSIGNED_CHAR, &layout.subarrayType);
+			MPI_Type_commit(&layout.subarrayType);
+
+			MPI_Pack_size(1, layout.vectorType, MPI_COMM_WORLD, &layout.packedBytes);
+
+			for (int method = 0; method < LAYOUT_METHOD_COUNT; method++)
+			{
+				// the packed bytes go through the send and receive buffers,
+				// which are maximumSize bytes
+				if (LAYOUT_METHODS[method].run == sendPacked && layout.packedBytes > maximumSize)
+				{
+					if (myRank == 0)
+					{
+						cerr << "Not packing " << bytes << " bytes at stride " << layout.stride << ", MPI_Pack_size is " << layout.packedBytes
+							<< " and the send buffer only " << maximumSize << " bytes" << endl;
+					}
+					continue;
+				}
+
+				long long span = (blocks - 1) * layout.stride + blockBytes;
+				fillStrided(layout, layout.sendLayout, bytes);
+				memset(layout.receiveLayout, 0, span);
+				fillPattern(message.sendBuffer, bytes);
+				memset(message.receiveBuffer, 0, bytes);
+				MPI_Barrier(MPI_COMM_WORLD);
+
+				for (int iteration = 0; iteration < warmup; iteration++)
+				{
+					LAYOUT_METHODS[method].run(myRank, message, layout);
+				}
+				for (int iteration = 0; iteration < iterations; iteration++)
+				{
+					times[iteration] = LAYOUT_METHODS[method].run(myRank, message, layout);
+				}
+
+				long long errors = 0;
+				if (myRank < 2)
+				{
+					errors = LAYOUT_METHODS[method].strided ? checkStrided(layout, layout.receiveLayout, bytes) : checkPattern(message.receiveBuffer, bytes);
+				}
+				long long totalErrors;
+				MPI_Reduce(&errors, &totalErrors, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+				if (myRank == 0)
+				{
+					SweepResult result = summarize(LAYOUT_METHODS[method].name, bytes, 1, totalErrors, times);
+					double bandwidth = (result.median > 0) ? bytes / result.median / 1e6 : 0;
+
+					out << fixed << setprecision(3);
+					if (json)
+					{
+						out << "{\"method\": \"" << result.mode << "\", \"bytes\": " << bytes << ", \"block_bytes\": " << blockBytes << ", \"stride_bytes\": " << layout.stride
+							<< ", \"iterations\": " << iterations << ", \"wrong_bytes\": " << totalErrors << ", \"min_us\": " << result.minimum * 1e6
+							<< ", \"median_us\": " << result.median * 1e6 << ", \"p99_us\": " << result.p99 * 1e6 << ", \"max_us\": " << result.maximum * 1e6
+							<< ", \"bandwidth_MBps\": " << bandwidth << "}" << endl;
+					}
+					else
+					{
+						out << result.mode << "," << bytes << "," << blockBytes << "," << layout.stride << "," << iterations << "," << totalErrors << ","
+							<< result.minimum * 1e6 << "," << result.median * 1e6 << "," << result.p99 * 1e6 << "," << result.maximum * 1e6 << "," << bandwidth << endl;
+					}
+				}
+			}
+
+			MPI_Type_free(&layout.vectorType);
+			MPI_Type_free(&layout.subarrayType);
+		}
+	}
+
+	free(layout.sendLayout);
+	free(layout.receiveLayout);
 }